@@ -0,0 +1,129 @@
+#include "AlarmRules.h"
+
+uint16_t holidays[MAX_HOLIDAYS];
+int holidayCount = 0;
+
+uint8_t dayOfWeekFromDay(uint32_t day)
+{
+  return (day + 6) % 7;
+}
+
+// Gregorian date -> day number (days_from_civil, valid from 2000 onwards)
+uint32_t dayFromDate(int year, int month, int dayOfMonth)
+{
+  year -= month <= 2;
+  uint32_t era = year / 400;
+  uint32_t yoe = year - era * 400;
+  uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + dayOfMonth - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 730425; // 730425 days from 0000-03-01 to 2000-01-01
+}
+
+void dateFromDay(uint32_t day, int &year, int &month, int &dayOfMonth)
+{
+  uint32_t z = day + 730425;
+  uint32_t era = z / 146097;
+  uint32_t doe = z - era * 146097;
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  dayOfMonth = doy - (153 * mp + 2) / 5 + 1;
+  month = mp < 10 ? mp + 3 : mp - 9;
+  year = era * 400 + yoe + (month <= 2);
+}
+
+int daysInMonth(int year, int month)
+{
+  static const uint8_t lengths[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if (month == 2 && (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)))
+    return 29;
+  return lengths[month - 1];
+}
+
+// nth (1..4) or last (5) given weekday of a month
+uint32_t nthWeekdayOfMonth(int year, int month, uint8_t nth, uint8_t weekday)
+{
+  uint32_t first = dayFromDate(year, month, 1);
+  if (nth >= 5)
+  {
+    uint32_t last = first + daysInMonth(year, month) - 1;
+    return last - (dayOfWeekFromDay(last) + 7 - weekday) % 7;
+  }
+  return first + (weekday + 7 - dayOfWeekFromDay(first)) % 7 + (nth - 1) * 7;
+}
+
+bool isHoliday(uint32_t day)
+{
+  int lo = 0, hi = holidayCount - 1;
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    if (holidays[mid] == day)
+      return true;
+    if (holidays[mid] < day)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return false;
+}
+
+uint32_t nextRuleDay(const CompiledRule &rule, uint32_t day)
+{
+  switch (rule.kind)
+  {
+  case REPEAT_WEEKLY:
+  {
+    if (rule.weekMask == 0)
+      return RULE_NO_DAY;
+    // Rotate the mask so bit 0 is `day`, the lowest set bit is the distance to the next match
+    uint8_t dow = dayOfWeekFromDay(day);
+    uint8_t rotated = ((rule.weekMask >> dow) | (rule.weekMask << (7 - dow))) & 0x7F;
+    return day + __builtin_ctz(rotated);
+  }
+  case REPEAT_ONCE:
+    return rule.anchorDay >= day ? rule.anchorDay : RULE_NO_DAY;
+  case REPEAT_EVERY_N_DAYS:
+  {
+    if (day <= rule.anchorDay)
+      return rule.anchorDay;
+    uint32_t steps = (day - rule.anchorDay + rule.interval - 1) / rule.interval;
+    uint32_t next = rule.anchorDay + steps * rule.interval;
+    return next < RULE_NO_DAY ? next : RULE_NO_DAY;
+  }
+  case REPEAT_NTH_WEEKDAY:
+  {
+    int year, month, dayOfMonth;
+    dateFromDay(day, year, month, dayOfMonth);
+    uint32_t candidate = nthWeekdayOfMonth(year, month, rule.nth, rule.weekday);
+    if (candidate >= day)
+      return candidate;
+    if (++month > 12)
+    {
+      month = 1;
+      year++;
+    }
+    return nthWeekdayOfMonth(year, month, rule.nth, rule.weekday);
+  }
+  }
+  return RULE_NO_DAY;
+}
+
+// Each excluded holiday costs one extra O(1) step, so this is bounded by holidayCount.
+uint32_t nextRuleOccurrence(const CompiledRule &rule, uint32_t from)
+{
+  uint32_t since2000 = from > EPOCH_2000_UNIX ? from - EPOCH_2000_UNIX : 0;
+  uint32_t day = since2000 / 86400;
+  if (rule.minuteOfDay * 60UL < since2000 % 86400)
+    day++;
+
+  day = nextRuleDay(rule, day);
+  while (day != RULE_NO_DAY && rule.skipHolidays && isHoliday(day))
+  {
+    day = nextRuleDay(rule, day + 1);
+  }
+
+  if (day >= RULE_NO_DAY)
+    return 0;
+  return EPOCH_2000_UNIX + day * 86400UL + rule.minuteOfDay * 60UL;
+}
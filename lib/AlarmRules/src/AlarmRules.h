@@ -0,0 +1,49 @@
+// Alarm recurrence rules on day numbers (days since 2000-01-01, a Saturday), so each kind
+// finds its next matching day arithmetically instead of walking the calendar. No Arduino
+// dependencies: the native tests cross-check it against a day-by-day evaluator.
+#pragma once
+
+#include <stdint.h>
+
+// Recurrence kinds (Alarm::repeat)
+enum AlarmRepeat : uint8_t
+{
+  REPEAT_WEEKLY,       // daysOfWeek
+  REPEAT_ONCE,         // startDay only
+  REPEAT_EVERY_N_DAYS, // startDay + k * interval
+  REPEAT_NTH_WEEKDAY   // nth (1..4, 5 = last) weekday of every month
+};
+
+#define RULE_NO_DAY 0xFFFF
+#define EPOCH_2000_UNIX 946684800UL
+
+// Compact form of an Alarm's schedule, rebuilt whenever alarms[] changes
+struct CompiledRule
+{
+  uint8_t kind = REPEAT_WEEKLY;
+  uint8_t weekMask = 0; // Bit d set = fires on day-of-week d (0 = Sunday)
+  uint8_t nth = 1;
+  uint8_t weekday = 0;
+  uint16_t interval = 1;
+  uint16_t anchorDay = 0;
+  uint16_t minuteOfDay = 0;
+  bool skipHolidays = false;
+};
+
+// Exclusion dates shared by all alarms with skipHolidays, kept sorted for binary search
+#define MAX_HOLIDAYS 32
+extern uint16_t holidays[MAX_HOLIDAYS];
+extern int holidayCount;
+
+uint8_t dayOfWeekFromDay(uint32_t day);
+uint32_t dayFromDate(int year, int month, int dayOfMonth);
+void dateFromDay(uint32_t day, int &year, int &month, int &dayOfMonth);
+int daysInMonth(int year, int month);
+uint32_t nthWeekdayOfMonth(int year, int month, uint8_t nth, uint8_t weekday);
+bool isHoliday(uint32_t day);
+
+// First day >= `day` the rule fires on (ignoring holidays), RULE_NO_DAY if never
+uint32_t nextRuleDay(const CompiledRule &rule, uint32_t day);
+
+// First fire instant (RTC unix time) at or after `from`, 0 if the rule never fires again
+uint32_t nextRuleOccurrence(const CompiledRule &rule, uint32_t from);
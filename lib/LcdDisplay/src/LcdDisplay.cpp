@@ -0,0 +1,320 @@
+#include "LcdDisplay.h"
+
+#include <string.h>
+
+char lcdFrame[LCD_ROWS][LCD_COLS];
+char lcdShown[LCD_ROWS][LCD_COLS];
+int8_t lcdCursorRow = -1;
+int8_t lcdCursorCol = -1;
+uint8_t lcdTx[LCD_TX_MAX];
+uint8_t lcdTxLen = 0;
+bool lcdBacklightOn = true;
+bool lcdDisplayOn = true;
+
+LcdConfig lcdConfig;
+DisplayState displayState;
+DisplayTaskStats displayStats;
+LcdStats lcdStats;
+
+// Queue one HD44780 byte (mode = LCD_PCF_RS for data, 0 for a command)
+void lcdTxByte(uint8_t value, uint8_t mode)
+{
+  if (lcdTxLen + 4 > LCD_TX_MAX)
+    lcdTxFlush();
+
+  uint8_t bits = mode | (lcdBacklightOn ? LCD_PCF_BACKLIGHT : 0);
+  uint8_t high = (value & 0xF0) | bits;
+  uint8_t low = ((value << 4) & 0xF0) | bits;
+  lcdTx[lcdTxLen++] = high | LCD_PCF_EN;
+  lcdTx[lcdTxLen++] = high; // falling EN latches the nibble
+  lcdTx[lcdTxLen++] = low | LCD_PCF_EN;
+  lcdTx[lcdTxLen++] = low;
+}
+
+// Send everything queued as a single I2C transaction
+void lcdTxFlush()
+{
+  if (lcdTxLen == 0)
+    return;
+  lcdBusWrite(lcdTx, lcdTxLen);
+  lcdTxLen = 0;
+}
+
+// Fill one framebuffer row, padding with spaces
+void lcdSetRow(int row, const char *text)
+{
+  int col = 0;
+  for (; col < LCD_COLS && text[col]; col++)
+    lcdFrame[row][col] = text[col];
+  for (; col < LCD_COLS; col++)
+    lcdFrame[row][col] = ' ';
+}
+
+// Write the dirty cells only. Unchanged cells between two dirty ones are rewritten
+// when that is no more bytes than a setCursor (1 command byte).
+void lcdFlush()
+{
+  bool wrote = false;
+  for (int row = 0; row < LCD_ROWS; row++)
+  {
+    int col = 0;
+    while (col < LCD_COLS)
+    {
+      if (lcdFrame[row][col] == lcdShown[row][col])
+      {
+        col++;
+        continue;
+      }
+
+      if (lcdCursorRow != row || lcdCursorCol != col)
+      {
+        lcdTxByte(0x80 | (row * 0x40 + col), 0); // Set DDRAM address
+        lcdStats.bytes++;
+        lcdStats.windowBytes++;
+      }
+
+      // Extend the run across single unchanged cells
+      int end = col;
+      while (end < LCD_COLS && (lcdFrame[row][end] != lcdShown[row][end] ||
+                                (end + 1 < LCD_COLS && lcdFrame[row][end + 1] != lcdShown[row][end + 1])))
+        end++;
+
+      for (int c = col; c < end; c++)
+      {
+        lcdTxByte((uint8_t)lcdFrame[row][c], LCD_PCF_RS);
+        lcdShown[row][c] = lcdFrame[row][c];
+      }
+      lcdStats.bytes += end - col;
+      lcdStats.windowBytes += end - col;
+      lcdCursorRow = row;
+      lcdCursorCol = end < LCD_COLS ? end : -1; // DDRAM of row 0 does not continue into row 1
+      col = end;
+      wrote = true;
+    }
+    lcdTxFlush(); // One transaction per row
+  }
+  if (wrote)
+    lcdStats.frames++;
+}
+
+// Blank the glass with the HD44780 clear command and keep the shadow in sync
+void lcdClear()
+{
+  lcdTxFlush();
+  lcdBusClear();
+  memset(lcdFrame, ' ', sizeof(lcdFrame));
+  memset(lcdShown, ' ', sizeof(lcdShown));
+  lcdCursorRow = 0;
+  lcdCursorCol = 0;
+  lcdStats.bytes++;
+  lcdStats.windowBytes++;
+}
+
+// Upload a CGRAM set (8 glyphs x 8 rows, the address auto-increments across slots)
+void lcdLoadGlyphs(uint8_t glyphs)
+{
+  const uint8_t(*table)[8] = NULL;
+  if (glyphs == GLYPHS_BIG_DIGITS)
+    table = bigDigitGlyphs;
+  else if (glyphs == GLYPHS_VIETNAMESE)
+    table = vietnameseGlyphs;
+  if (!table)
+    return;
+
+  lcdTxByte(0x40, 0); // Set CGRAM address 0
+  for (int slot = 0; slot < 8; slot++)
+    for (int row = 0; row < 8; row++)
+      lcdTxByte(table[slot][row], LCD_PCF_RS);
+  lcdTxFlush();
+  lcdStats.bytes += 1 + 64;
+  lcdStats.windowBytes += 1 + 64;
+  lcdCursorRow = -1; // Address counter now points into CGRAM
+  displayState.glyphs = glyphs;
+}
+
+// Fold one command into the task's state; re-posting the same content keeps the blink phase
+void applyDisplayCommand(const DisplayCommand &cmd)
+{
+  DisplayState &d = displayState;
+  if (cmd.layer >= LAYER_COUNT)
+    return;
+  DisplayLayer &layer = d.layers[cmd.layer];
+
+  switch (cmd.type)
+  {
+  case DISPLAY_SET_LAYER:
+  {
+    // Only at a mode switch: every later frame of the same mode asks for the loaded set.
+    // Text pages use the Vietnamese letters when enabled.
+    uint8_t wanted = cmd.glyphs;
+    if (cmd.layer == LAYER_BASE && wanted == GLYPHS_ANY && lcdConfig.vietnameseGlyphs)
+      wanted = GLYPHS_VIETNAMESE;
+    if (wanted != GLYPHS_ANY && wanted != d.glyphs)
+      lcdLoadGlyphs(wanted);
+
+    layer.expiresAt = cmd.ttlMs ? lcdMillis() + cmd.ttlMs : 0;
+    if (layer.active && layer.rowMask == cmd.rowMask && layer.blinkMs == cmd.blinkMs &&
+        !strcmp(layer.lines[0], cmd.line1) && !strcmp(layer.lines[1], cmd.line2))
+      break;
+    layer.active = true;
+    layer.rowMask = cmd.rowMask;
+    memcpy(layer.lines[0], cmd.line1, sizeof(layer.lines[0]));
+    memcpy(layer.lines[1], cmd.line2, sizeof(layer.lines[1]));
+    if (layer.blinkMs != cmd.blinkMs && d.blinkLayer == cmd.layer)
+      d.blinkLayer = LAYER_NONE; // restart the blink phase
+    layer.blinkMs = cmd.blinkMs;
+    break;
+  }
+  case DISPLAY_CLEAR_LAYER:
+    layer.active = false;
+    break;
+  }
+}
+
+// Drop notices whose TTL ran out; returns ms until the next expiry (or `limit`)
+unsigned long expireDisplayLayers(unsigned long limit)
+{
+  unsigned long now = lcdMillis();
+  for (int i = 0; i < LAYER_COUNT; i++)
+  {
+    DisplayLayer &layer = displayState.layers[i];
+    if (!layer.active || layer.expiresAt == 0)
+      continue;
+    long left = (long)(layer.expiresAt - now);
+    if (left <= 0)
+      layer.active = false;
+    else if ((unsigned long)left < limit)
+      limit = left;
+  }
+  return limit;
+}
+
+// Highest active layer covering `row` (the base when nothing does)
+int topDisplayLayer(int row)
+{
+  for (int i = LAYER_COUNT - 1; i > LAYER_BASE; i--)
+    if (displayState.layers[i].active && (displayState.layers[i].rowMask & (1 << row)))
+      return i;
+  return LAYER_BASE;
+}
+
+// Show or hide the panel without touching DDRAM
+void lcdSetVisible(bool visible)
+{
+  if (LCD_BLINK_BACKLIGHT)
+  {
+    lcdBacklightOn = visible;
+    lcdTx[lcdTxLen++] = visible ? LCD_PCF_BACKLIGHT : 0; // EN stays low: nothing is latched
+    lcdStats.bytes++;
+    lcdStats.windowBytes++;
+  }
+  else
+  {
+    lcdTxByte(visible ? LCD_CMD_DISPLAY_ON : LCD_CMD_DISPLAY_OFF, 0);
+    lcdStats.bytes++;
+    lcdStats.windowBytes++;
+  }
+  lcdTxFlush();
+  lcdDisplayOn = visible;
+}
+
+// Put a line into the framebuffer, through the row's marquee window when it is too long
+void renderRow(int row, const char *text)
+{
+  char lcdText[LCD_LINE_MAX + 1];
+  lcdTransliterate(text, lcdText, sizeof(lcdText), displayState.glyphs == GLYPHS_VIETNAMESE);
+
+  MarqueeRow &m = displayState.marquee[row];
+  if (strcmp(m.source, lcdText))
+  {
+    strcpy(m.source, lcdText);
+    m.length = strlen(m.source);
+    m.offset = 0;
+    m.nextStep = lcdMillis() + MARQUEE_HOLD_MS;
+  }
+
+  if (m.length <= LCD_COLS)
+  {
+    lcdSetRow(row, lcdText);
+    return;
+  }
+
+  int period = m.length + MARQUEE_GAP;
+  for (int col = 0; col < LCD_COLS; col++)
+  {
+    int index = (m.offset + col) % period;
+    lcdFrame[row][col] = index < m.length ? m.source[index] : ' ';
+  }
+}
+
+// Advance due marquees; returns ms until the next step (or `limit`)
+unsigned long stepMarquees(unsigned long limit)
+{
+  unsigned long now = lcdMillis();
+  for (int row = 0; row < LCD_ROWS; row++)
+  {
+    MarqueeRow &m = displayState.marquee[row];
+    if (m.length <= LCD_COLS)
+      continue;
+
+    if ((long)(now - m.nextStep) >= 0)
+    {
+      m.offset = (m.offset + 1) % (m.length + MARQUEE_GAP);
+      m.nextStep = now + (m.offset == 0 ? MARQUEE_HOLD_MS : lcdConfig.scrollMs);
+    }
+    unsigned long until = m.nextStep - now;
+    if (until < limit)
+      limit = until;
+  }
+  return limit;
+}
+
+// Compose the layers into the framebuffer and flush the difference
+void renderDisplay()
+{
+  DisplayState &d = displayState;
+  int top = LAYER_BASE;
+  for (int row = 0; row < LCD_ROWS; row++)
+  {
+    int layer = topDisplayLayer(row);
+    renderRow(row, d.layers[layer].lines[row]);
+    if (layer > top)
+      top = layer;
+  }
+
+  // The panel blinks with the topmost layer; a new blinking layer starts visible
+  uint16_t blinkMs = d.layers[top].blinkMs;
+  if (blinkMs == 0)
+  {
+    d.blinkLayer = LAYER_NONE;
+    d.blinkVisible = true;
+  }
+  else if (d.blinkLayer != top)
+  {
+    d.blinkLayer = top;
+    d.blinkVisible = true;
+    d.nextBlink = lcdMillis() + blinkMs;
+  }
+
+  lcdFlush();
+  if (d.blinkVisible != lcdDisplayOn)
+    lcdSetVisible(d.blinkVisible);
+  displayStats.renders++;
+}
+
+// Toggle the panel when the running blink is due
+void stepDisplayBlink()
+{
+  DisplayState &d = displayState;
+  if (d.blinkLayer == LAYER_NONE || (long)(lcdMillis() - d.nextBlink) < 0)
+    return;
+
+  const DisplayLayer &blinking = d.layers[d.blinkLayer];
+  d.blinkVisible = !d.blinkVisible;
+  d.nextBlink += blinking.blinkMs;
+
+  // The old blinker cleared on the off edge and reprinted everything on the on edge
+  uint32_t legacy = d.blinkVisible ? 1 + 2 + strlen(blinking.lines[0]) + strlen(blinking.lines[1]) : 1;
+  lcdStats.legacyBytes += legacy;
+  lcdStats.windowLegacyBytes += legacy;
+}
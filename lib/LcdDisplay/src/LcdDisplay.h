@@ -0,0 +1,154 @@
+// Display pipeline for the 16x2 LCD behind a PCF8574 backpack. Prioritised layers are
+// composed into a shadow framebuffer, only the dirty cells are encoded, and each row goes
+// out as one batched I2C write. The bus itself is reached through the three hooks at the
+// bottom: the firmware implements them with Wire, the native tests with an HD44780 model.
+#pragma once
+
+#include <stdint.h>
+#include "LcdText.h"
+
+// LCD framebuffer: what we want on the glass vs what was last written to DDRAM.
+// A cell is dirty while the two differ; lcdFlush() only sends the dirty runs.
+extern char lcdFrame[LCD_ROWS][LCD_COLS];
+extern char lcdShown[LCD_ROWS][LCD_COLS];
+extern int8_t lcdCursorRow; // DDRAM address after the last write, -1 = unknown
+extern int8_t lcdCursorCol;
+
+// Batched PCF8574 transport: a whole row update goes out as one Wire transaction,
+// 2 expander bytes per nibble (EN high, EN low). P0=RS P1=RW P2=EN P3=backlight P4-P7=D4-D7.
+#define LCD_PCF_RS 0x01
+#define LCD_PCF_EN 0x04
+#define LCD_PCF_BACKLIGHT 0x08
+#define LCD_TX_MAX 120 // stay under the 128-byte Wire buffer
+extern uint8_t lcdTx[LCD_TX_MAX];
+extern uint8_t lcdTxLen;
+extern bool lcdBacklightOn;
+extern bool lcdDisplayOn;
+
+// Blink by toggling the HD44780 display-enable bit (content stays in DDRAM, 1 command byte
+// per edge). Set to true to blink the backlight instead: a single expander byte, but the
+// text stays faintly readable on most panels.
+#define LCD_BLINK_BACKLIGHT false
+#define LCD_CMD_DISPLAY_ON 0x0C  // display on, cursor off, cursor blink off
+#define LCD_CMD_DISPLAY_OFF 0x08
+
+// Content lives in layers; each frame shows, per row, the highest active layer covering it.
+enum DisplayCommandType : uint8_t
+{
+  DISPLAY_SET_LAYER,
+  DISPLAY_CLEAR_LAYER,
+};
+
+enum DisplayLayerId : uint8_t
+{
+  LAYER_BASE,        // page engine
+  LAYER_COUNTDOWN,   // running timers
+  LAYER_MENU,        // on-device alarm editor
+  LAYER_NOTICE,      // transient messages with a TTL
+  LAYER_TIMER_ALERT, // expired timer
+  LAYER_ALARM,       // ringing alarm
+  LAYER_COUNT,
+  LAYER_NONE = LAYER_COUNT,
+};
+
+struct DisplayCommand
+{
+  uint8_t type;
+  uint8_t layer;
+  uint8_t rowMask;  // bit n = the layer covers row n, uncovered rows show what is below
+  uint8_t glyphs;   // CGRAM set the lines need
+  uint16_t blinkMs; // 0 = steady
+  uint16_t ttlMs;   // 0 = until cleared
+  char line1[LCD_TEXT_MAX + 1];
+  char line2[LCD_TEXT_MAX + 1];
+};
+
+// Lines longer than the panel scroll: the window moves one cell per step
+#define MARQUEE_GAP 3 // blank cells between the end and the wrapped start
+#define MARQUEE_HOLD_MS 1500 // pause on the first cells so the start is readable
+
+struct MarqueeRow
+{
+  char source[LCD_LINE_MAX + 1] = "";
+  uint8_t length = 0;
+  uint8_t offset = 0;
+  unsigned long nextStep = 0;
+};
+
+#define MAX_LCD_PAGES 8
+
+struct LcdConfig
+{
+  uint16_t scrollMs = 350;       // marquee step
+  bool vietnameseGlyphs = false; // draw ă â đ ê ô ơ ư Đ with CGRAM instead of plain letters
+  uint8_t pageOrder[MAX_LCD_PAGES] = {0, 1, 2}; // clock, weather, bigclock: the three modes before pages
+  uint8_t pageCount = 3;
+  uint16_t dwellSeconds = 60; // 0 = stay on the current page
+};
+extern LcdConfig lcdConfig;
+
+struct DisplayLayer
+{
+  bool active = false;
+  uint8_t rowMask = 0;
+  uint16_t blinkMs = 0;
+  unsigned long expiresAt = 0; // lcdMillis(), 0 = never
+  char lines[LCD_ROWS][LCD_TEXT_MAX + 1];
+};
+
+// Owned by the display task
+struct DisplayState
+{
+  DisplayLayer layers[LAYER_COUNT];
+  uint8_t glyphs = GLYPHS_ANY;     // set currently in CGRAM
+  uint8_t blinkLayer = LAYER_NONE; // layer whose blink is running
+  bool blinkVisible = true;
+  unsigned long nextBlink = 0;
+  MarqueeRow marquee[LCD_ROWS];
+};
+extern DisplayState displayState;
+
+struct DisplayTaskStats
+{
+  uint32_t commands = 0;
+  uint32_t coalesced = 0; // commands folded into a frame with others
+  uint32_t dropped = 0;   // queue full, the caller moved on
+  uint32_t renders = 0;
+};
+extern DisplayTaskStats displayStats;
+
+// LCD traffic, counted in HD44780 bytes (commands + characters). "legacy" is what the old
+// clear-and-reprint renderer would have sent for the same frames, for comparison.
+struct LcdStats
+{
+  uint32_t bytes = 0;
+  uint32_t legacyBytes = 0;
+  uint32_t frames = 0;
+  uint32_t bytesPerSec = 0;
+  uint32_t legacyBytesPerSec = 0;
+  uint32_t windowBytes = 0;
+  uint32_t windowLegacyBytes = 0;
+  unsigned long windowStart = 0;
+};
+extern LcdStats lcdStats;
+
+void lcdTxByte(uint8_t value, uint8_t mode);
+void lcdTxFlush();
+void lcdSetRow(int row, const char *text);
+void lcdFlush();
+void lcdClear();
+void lcdLoadGlyphs(uint8_t glyphs);
+void lcdSetVisible(bool visible);
+
+void applyDisplayCommand(const DisplayCommand &cmd);
+unsigned long expireDisplayLayers(unsigned long limit);
+int topDisplayLayer(int row);
+void renderRow(int row, const char *text);
+unsigned long stepMarquees(unsigned long limit);
+void renderDisplay();
+void stepDisplayBlink();
+
+// Provided by the application
+unsigned long lcdMillis();                         // monotonic ms for TTLs, marquee and blink
+void lcdBusWrite(const uint8_t *bytes, int count); // one transaction of expander bytes
+void lcdBusClear();                                // HD44780 clear, including its 1.5 ms wait
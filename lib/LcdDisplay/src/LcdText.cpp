@@ -0,0 +1,243 @@
+#include "LcdText.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Big digits: 3x2 cells per digit built from 8 segment glyphs plus the full block (0xFF)
+const uint8_t bigDigitGlyphs[8][8] = {
+    {0x07, 0x0F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F}, // 8  top-left
+    {0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00}, // 9  upper bar
+    {0x1C, 0x1E, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F}, // 10 top-right
+    {0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x0F, 0x07}, // 11 bottom-left
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F}, // 12 lower bar
+    {0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1E, 0x1C}, // 13 bottom-right
+    {0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x1F, 0x1F}, // 14 upper + middle bar
+    {0x1F, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F}, // 15 lower + middle bar
+};
+
+const char bigDigitCells[10][2][4] = {
+    {"\x08\x09\x0A", "\x0B\x0C\x0D"}, // 0
+    {"\x09\x0A ", "\x0C\xFF\x0C"},     // 1
+    {"\x0E\x0E\x0A", "\x0B\x0C\x0C"}, // 2
+    {"\x0E\x0E\x0A", "\x0C\x0C\x0D"}, // 3
+    {"\x0B\x0C\xFF", "  \xFF"},         // 4
+    {"\x0B\x0E\x0E", "\x0C\x0C\x0D"}, // 5
+    {"\x08\x0E\x0E", "\x0B\x0C\x0D"}, // 6
+    {"\x09\x09\x0A", "  \xFF"},         // 7
+    {"\x08\x0E\x0A", "\x0B\x0C\x0D"}, // 8
+    {"\x08\x0E\x0A", "\x0F\x0F\x0D"}, // 9
+};
+
+// ==========================================
+// VIETNAMESE TEXT ON THE HD44780
+// ==========================================
+// The A00 character ROM has no Vietnamese letters, so UTF-8 text is transliterated
+// to its base letters. Optionally the 8 most distinctive base shapes come from CGRAM.
+
+const uint8_t vietnameseGlyphs[8][8] = {
+    {0x11, 0x0E, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x00}, // 8  ă
+    {0x04, 0x0A, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x00}, // 9  â
+    {0x01, 0x07, 0x0D, 0x13, 0x11, 0x11, 0x0F, 0x00}, // 10 đ
+    {0x04, 0x0A, 0x0E, 0x11, 0x1F, 0x10, 0x0E, 0x00}, // 11 ê
+    {0x04, 0x0A, 0x0E, 0x11, 0x11, 0x11, 0x0E, 0x00}, // 12 ô
+    {0x00, 0x01, 0x0F, 0x11, 0x11, 0x11, 0x0E, 0x00}, // 13 ơ
+    {0x01, 0x01, 0x12, 0x12, 0x12, 0x16, 0x0A, 0x00}, // 14 ư
+    {0x0E, 0x09, 0x09, 0x1D, 0x09, 0x09, 0x0E, 0x00}, // 15 Đ
+};
+
+// Code point range -> base letter. Where upper != lower the range alternates
+// upper/lower case starting with upper (how Unicode lays out Vietnamese letters).
+// Glyph = CGRAM slot + 1 for the lower/upper result, 0 = none.
+struct VnMapping
+{
+  uint16_t first;
+  uint16_t last;
+  char upper;
+  char lower;
+  uint8_t lowerGlyph;
+  uint8_t upperGlyph;
+};
+
+constexpr VnMapping vnMappings[] = {
+    {0x00B0, 0x00B0, (char)0xDF, (char)0xDF, 0, 0}, // ° -> ROM degree sign
+    {0x00B7, 0x00B7, (char)0xA5, (char)0xA5, 0, 0}, // · -> ROM centered dot
+    {0x00C0, 0x00C3, 'A', 'A', 0, 0},
+    {0x00C8, 0x00CA, 'E', 'E', 0, 0},
+    {0x00CC, 0x00CD, 'I', 'I', 0, 0},
+    {0x00D2, 0x00D5, 'O', 'O', 0, 0},
+    {0x00D9, 0x00DA, 'U', 'U', 0, 0},
+    {0x00DD, 0x00DD, 'Y', 'Y', 0, 0},
+    {0x00E0, 0x00E1, 'a', 'a', 0, 0},
+    {0x00E2, 0x00E2, 'a', 'a', 2, 2}, // â
+    {0x00E3, 0x00E3, 'a', 'a', 0, 0},
+    {0x00E8, 0x00E9, 'e', 'e', 0, 0},
+    {0x00EA, 0x00EA, 'e', 'e', 4, 4}, // ê
+    {0x00EC, 0x00ED, 'i', 'i', 0, 0},
+    {0x00F2, 0x00F3, 'o', 'o', 0, 0},
+    {0x00F4, 0x00F4, 'o', 'o', 5, 5}, // ô
+    {0x00F5, 0x00F5, 'o', 'o', 0, 0},
+    {0x00F9, 0x00FA, 'u', 'u', 0, 0},
+    {0x00FD, 0x00FD, 'y', 'y', 0, 0},
+    {0x0102, 0x0103, 'A', 'a', 1, 0}, // Ă ă
+    {0x0110, 0x0111, 'D', 'd', 3, 8}, // Đ đ
+    {0x0128, 0x0129, 'I', 'i', 0, 0},
+    {0x0168, 0x0169, 'U', 'u', 0, 0},
+    {0x01A0, 0x01A1, 'O', 'o', 6, 0}, // Ơ ơ
+    {0x01AF, 0x01B0, 'U', 'u', 7, 0}, // Ư ư
+    {0x0300, 0x0303, 0, 0, 0, 0},     // Combining marks (NFD input) are dropped: grave, acute, circumflex, tilde
+    {0x0306, 0x0306, 0, 0, 0, 0},     // breve
+    {0x0309, 0x0309, 0, 0, 0, 0},     // hook above
+    {0x031B, 0x031B, 0, 0, 0, 0},     // horn
+    {0x0323, 0x0323, 0, 0, 0, 0},     // dot below
+    {0x1EA0, 0x1EA3, 'A', 'a', 0, 0}, // Ạ Ả
+    {0x1EA4, 0x1EAD, 'A', 'a', 2, 0}, // Ấ Ầ Ẩ Ẫ Ậ
+    {0x1EAE, 0x1EB7, 'A', 'a', 1, 0}, // Ắ Ằ Ẳ Ẵ Ặ
+    {0x1EB8, 0x1EBD, 'E', 'e', 0, 0}, // Ẹ Ẻ Ẽ
+    {0x1EBE, 0x1EC7, 'E', 'e', 4, 0}, // Ế Ề Ể Ễ Ệ
+    {0x1EC8, 0x1ECB, 'I', 'i', 0, 0}, // Ỉ Ị
+    {0x1ECC, 0x1ECF, 'O', 'o', 0, 0}, // Ọ Ỏ
+    {0x1ED0, 0x1ED9, 'O', 'o', 5, 0}, // Ố Ồ Ổ Ỗ Ộ
+    {0x1EDA, 0x1EE3, 'O', 'o', 6, 0}, // Ớ Ờ Ở Ỡ Ợ
+    {0x1EE4, 0x1EE7, 'U', 'u', 0, 0}, // Ụ Ủ
+    {0x1EE8, 0x1EF1, 'U', 'u', 7, 0}, // Ứ Ừ Ử Ữ Ự
+    {0x1EF2, 0x1EF9, 'Y', 'y', 0, 0}, // Ỳ Ỵ Ỷ Ỹ
+};
+constexpr int VN_MAPPING_COUNT = sizeof(vnMappings) / sizeof(vnMappings[0]);
+
+constexpr bool vnMappingsSorted(int i)
+{
+  return i + 1 >= VN_MAPPING_COUNT ||
+         (vnMappings[i].first <= vnMappings[i].last && vnMappings[i].last < vnMappings[i + 1].first && vnMappingsSorted(i + 1));
+}
+static_assert(vnMappingsSorted(0), "vnMappings must be sorted and non-overlapping for the binary search");
+
+// Binary search; NULL when the code point has no mapping
+const VnMapping *findVnMapping(uint16_t codePoint)
+{
+  int lo = 0, hi = VN_MAPPING_COUNT - 1;
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    if (codePoint < vnMappings[mid].first)
+      hi = mid - 1;
+    else if (codePoint > vnMappings[mid].last)
+      lo = mid + 1;
+    else
+      return &vnMappings[mid];
+  }
+  return NULL;
+}
+
+int lcdTransliterate(const char *text, char *out, int outSize, bool glyphs)
+{
+  const uint8_t *p = (const uint8_t *)text;
+  int n = 0;
+  while (*p && n < outSize - 1)
+  {
+    uint8_t lead = *p;
+    int extra = lead >= 0xC2 && lead <= 0xDF ? 1 : lead >= 0xE0 && lead <= 0xEF ? 2 : lead >= 0xF0 && lead <= 0xF4 ? 3 : 0;
+    bool valid = extra > 0;
+    for (int i = 1; valid && i <= extra; i++)
+      valid = (p[i] & 0xC0) == 0x80;
+
+    if (!valid)
+    {
+      out[n++] = *p++;
+      continue;
+    }
+
+    uint32_t codePoint = lead & (0x3F >> extra);
+    for (int i = 1; i <= extra; i++)
+      codePoint = (codePoint << 6) | (p[i] & 0x3F);
+    p += extra + 1;
+
+    const VnMapping *m = codePoint <= 0xFFFF ? findVnMapping(codePoint) : NULL;
+    if (!m)
+    {
+      out[n++] = '?';
+      continue;
+    }
+
+    bool upper = m->upper == m->lower || ((codePoint - m->first) & 1) == 0;
+    uint8_t glyph = upper ? m->upperGlyph : m->lowerGlyph;
+    char ch = upper ? m->upper : m->lower;
+    if (glyphs && glyph)
+      out[n++] = 8 + glyph - 1;
+    else if (ch)
+      out[n++] = ch;
+  }
+  out[n] = '\0';
+  return n;
+}
+
+int utf8Copy(char *out, int outSize, const char *text, int maxCells)
+{
+  const uint8_t *p = (const uint8_t *)text;
+  int n = 0, cells = 0;
+  while (p[n])
+  {
+    uint8_t lead = p[n];
+    int length = lead >= 0xC2 && lead <= 0xDF ? 2 : lead >= 0xE0 && lead <= 0xEF ? 3 : lead >= 0xF0 && lead <= 0xF4 ? 4 : 1;
+    int i = 1;
+    while (i < length && (p[n + i] & 0xC0) == 0x80)
+      i++;
+    if (i < length)
+    {
+      if (p[n + i] == '\0')
+        break; // truncated upstream
+      length = 1;
+    }
+    bool combining = length == 2 && (lead == 0xCC || (lead == 0xCD && p[n + 1] <= 0xAF)); // U+0300..U+036F
+    if ((!combining && cells == maxCells) || n + length > outSize - 1)
+      break;
+    n += length;
+    if (!combining)
+      cells++;
+  }
+  memcpy(out, text, n);
+  out[n] = '\0';
+  return n;
+}
+
+// ==========================================
+// CLOCK FACES
+// ==========================================
+
+uint8_t formatClockLines(char *line1, char *line2, int hour, int minute, int second,
+                         int day, int month, int year, float tempC, const char *status)
+{
+  snprintf(line1, LCD_TEXT_MAX + 1, "%02d:%02d:%02d %4.1fC", hour, minute, second, tempC);
+  snprintf(line2, LCD_TEXT_MAX + 1, "%02d/%02d/%02d %s", day, month, year % 100, status);
+  return GLYPHS_ANY;
+}
+
+uint8_t formatBigClockLines(char *line1, char *line2, int hour, int minute, int second)
+{
+  // Layout (16 cols): digit 0-2 | gap | digit 4-6 | colon 7 | gap | digit 9-11 | gap | digit 13-15
+  memset(line1, ' ', LCD_COLS);
+  memset(line2, ' ', LCD_COLS);
+  line1[LCD_COLS] = line2[LCD_COLS] = '\0';
+
+  int digits[4] = {hour / 10, hour % 10, minute / 10, minute % 10};
+  const int columns[4] = {0, 4, 9, 13};
+  for (int i = 0; i < 4; i++)
+  {
+    memcpy(line1 + columns[i], bigDigitCells[digits[i]][0], 3);
+    memcpy(line2 + columns[i], bigDigitCells[digits[i]][1], 3);
+  }
+
+  // Colon blinks with the seconds: 2 cells per second, the rest of the frame is unchanged
+  if (second % 2 == 0)
+    line1[7] = line2[7] = (char)0xA5; // centered dot in the A00 ROM
+  return GLYPHS_BIG_DIGITS;
+}
+
+void formatCountdownLine(char *line, int size, unsigned long remainingSeconds, int others)
+{
+  int minutes = remainingSeconds / 60;
+  int seconds = remainingSeconds % 60;
+  if (others > 0)
+    snprintf(line, size, "TIMER: %02d:%02d +%d", minutes, seconds, others);
+  else
+    snprintf(line, size, "TIMER: %02d:%02d", minutes, seconds);
+}
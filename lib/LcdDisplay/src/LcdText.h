@@ -0,0 +1,42 @@
+// Text for a 16x2 HD44780 with the A00 character ROM: UTF-8 handling, the CGRAM glyph
+// sets and the line layouts of the clock faces. No Arduino dependencies, so the native
+// tests exercise exactly what the firmware runs.
+#pragma once
+
+#include <stdint.h>
+
+#define LCD_COLS 16
+#define LCD_ROWS 2
+#define LCD_LINE_MAX 40 // longest text line (one HD44780 DDRAM line), longer than LCD_COLS scrolls
+#define LCD_TEXT_MAX 64 // UTF-8 bytes per line in display commands (Vietnamese letters take 2-3)
+
+// CGRAM glyph sets. Text refers to slot n as code 8 + n (CGRAM is mirrored there),
+// which keeps '\0' free as the string terminator.
+#define GLYPHS_ANY 0 // keep whatever is loaded
+#define GLYPHS_BIG_DIGITS 1
+#define GLYPHS_VIETNAMESE 2
+
+extern const uint8_t bigDigitGlyphs[8][8];
+extern const char bigDigitCells[10][2][4];
+extern const uint8_t vietnameseGlyphs[8][8];
+
+// Copy UTF-8 text without splitting a sequence: at most maxCells characters (combining
+// marks ride on the previous one) and outSize - 1 bytes. A sequence cut short by the end
+// of the input is dropped; other stray bytes (raw ROM codes) are copied as they are.
+// Returns the bytes copied.
+int utf8Copy(char *out, int outSize, const char *text, int maxCells);
+
+// UTF-8 -> LCD character codes in one pass, into a caller buffer (no heap).
+// Bytes that are not valid UTF-8 pass through untouched, so glyph codes (8-15)
+// and ROM characters above 0x7F can be mixed into the text. Returns the length.
+int lcdTransliterate(const char *text, char *out, int outSize, bool glyphs);
+
+// Clock page: "HH:MM:SS TT.TC" over "DD/MM/YY STATUS". Lines are LCD_TEXT_MAX + 1 bytes.
+uint8_t formatClockLines(char *line1, char *line2, int hour, int minute, int second,
+                         int day, int month, int year, float tempC, const char *status);
+
+// HH:MM in 3x2-cell digits from the GLYPHS_BIG_DIGITS set, colon on even seconds
+uint8_t formatBigClockLines(char *line1, char *line2, int hour, int minute, int second);
+
+// "TIMER: MM:SS", plus "+n" when n more timers run behind the soonest one
+void formatCountdownLine(char *line, int size, unsigned long remainingSeconds, int others);
@@ -0,0 +1,98 @@
+// 10k Beta 3950 NTC against a 10k resistor on a 12-bit ADC: R/R0 = adc / (4095 - adc) and
+// 1/T = ln(R/R0)/Beta + 1/T0. The curve is evaluated by the compiler into a table of
+// centi-degrees every NTC_LUT_STEP codes; at run time a reading is one table lookup and a
+// linear interpolation, with no log() and no float division.
+#pragma once
+
+#include <stdint.h>
+
+#define NTC_BETA 3950.0
+#define NTC_T0_KELVIN 298.15
+#define NTC_LUT_SHIFT 4
+#define NTC_LUT_STEP (1 << NTC_LUT_SHIFT)
+#define NTC_LUT_SIZE ((4096 >> NTC_LUT_SHIFT) + 1)
+#define NTC_MIN_CENTI -5500 // past this the curve is off the sensor's range anyway
+#define NTC_MAX_CENTI 15000
+
+// ln() the compiler can run: reduce to [1, 2) by powers of two, then the atanh series
+constexpr double ntcLn(double x)
+{
+  int exponent = 0;
+  while (x >= 2.0)
+  {
+    x /= 2.0;
+    exponent++;
+  }
+  while (x < 1.0)
+  {
+    x *= 2.0;
+    exponent--;
+  }
+  double y = (x - 1.0) / (x + 1.0); // <= 1/3, the series converges fast
+  double term = y, sum = 0.0;
+  for (int n = 1; n < 40; n += 2)
+  {
+    sum += term / n;
+    term *= y * y;
+  }
+  return 2.0 * sum + exponent * 0.69314718055994530942;
+}
+
+// The reference equation, in °C (codes pinned off the rails, where it diverges)
+constexpr double ntcReferenceCelsius(int adc)
+{
+  double code = adc < 1 ? 1 : adc > 4094 ? 4094 : adc;
+  return 1.0 / (ntcLn(code / (4095.0 - code)) / NTC_BETA + 1.0 / NTC_T0_KELVIN) - 273.15;
+}
+
+struct NtcTable
+{
+  int16_t centi[NTC_LUT_SIZE];
+};
+
+constexpr NtcTable buildNtcTable()
+{
+  NtcTable table = {};
+  for (int i = 0; i < NTC_LUT_SIZE; i++)
+  {
+    double centi = ntcReferenceCelsius(i << NTC_LUT_SHIFT) * 100.0;
+    centi = centi < NTC_MIN_CENTI ? NTC_MIN_CENTI : centi > NTC_MAX_CENTI ? NTC_MAX_CENTI : centi;
+    table.centi[i] = (int16_t)(centi < 0 ? centi - 0.5 : centi + 0.5);
+  }
+  return table;
+}
+
+constexpr NtcTable ntcTable = buildNtcTable();
+
+constexpr int ntcCentiCelsius(int adc)
+{
+  int code = adc < 0 ? 0 : adc > 4095 ? 4095 : adc;
+  int i = code >> NTC_LUT_SHIFT;
+  int fraction = code & (NTC_LUT_STEP - 1);
+  return ntcTable.centi[i] + (ntcTable.centi[i + 1] - ntcTable.centi[i]) * fraction / NTC_LUT_STEP;
+}
+
+// Worst table error against the reference over the codes whose true temperature lies
+// in [minC, maxC], in centi-degrees
+constexpr int ntcMaxErrorCenti(double minC, double maxC)
+{
+  double worst = 0;
+  for (int code = 1; code < 4095; code++)
+  {
+    double reference = ntcReferenceCelsius(code);
+    if (reference < minC || reference > maxC)
+      continue;
+    double error = ntcCentiCelsius(code) - reference * 100.0;
+    if (error < 0)
+      error = -error;
+    if (error > worst)
+      worst = error;
+  }
+  return (int)(worst + 0.999);
+}
+
+static_assert(ntcCentiCelsius(2048) == 2499, "mid-scale is ~25 °C (R = R0)");
+static_assert(ntcCentiCelsius(462) > 7950 && ntcCentiCelsius(462) < 8050, "~80 °C near code 462");
+static_assert(ntcCentiCelsius(3813) > -2450 && ntcCentiCelsius(3813) < -2350, "~-24 °C near code 3813");
+static_assert(ntcCentiCelsius(1000) > ntcCentiCelsius(1001), "hotter = lower code");
+static_assert(ntcMaxErrorCenti(-40, 125) <= 10, "table within 0.1 °C of the Beta equation");
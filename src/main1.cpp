@@ -9,6 +9,18 @@
 #include <EEPROM.h>
 #include <Preferences.h>
 #include <time.h> // Include time.h for NTP
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+#include <soc/ledc_struct.h>
+#include <driver/gpio.h>
+#include <hal/cpu_hal.h>
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#include <atomic>
+#include <algorithm>
+#include <LcdDisplay.h>
+#include <AlarmRules.h>
+#include <NtcTable.h>
 
 // ==========================================
 // FORWARD DECLARATIONS
@@ -16,17 +28,50 @@
 
 // Display functions
 void switchLcdDisplayMode();
-void updateLCDContent(String line1, String line2);
-void displayClock();
+bool updateLCDContent(String line1, String line2);
+void setBusClock(uint32_t hz);
+DateTime readRtc();
+bool rtcBegin(bool startIfHalted = false);
+void rtcAdjust(const DateTime &time);
+void updateLcdStats();
+void startDisplayTask();
+bool postDisplayCommand(const struct DisplayCommand &cmd);
+bool postDisplayLines(const char *line1, const char *line2, uint8_t glyphs);
+bool displayOverlay(uint8_t layer, const char *line1, const char *line2, uint16_t blinkMs);
+bool displayClearOverlay(uint8_t layer);
+void displayNotice(const char *line1, const char *line2, uint16_t ttlMs);
+void displayPages();
 void displayCountdown();
 
 // Alarm & Timer functions
+int startTimer(unsigned long durationSeconds, const char *label);
+int startProgram(const struct TimerPhase *phases, int phaseCount, int rounds, const char *label);
+int addTimer(const struct CountdownTimer &setup, uint32_t elapsedSeconds);
+void stopTimer(int index);
+unsigned long timerRemaining(int index);
+void checkTimers();
+void setupTimerClock();
+void armTimerClock();
+void compileAlarmRules();
+void scheduleAlarms(uint32_t from);
 void triggerAlarm(int index);
 void stopAlarm();
+void snoozeAlarm();
+void dismissAlarm();
+void deleteAlarm(int index);
+uint16_t nextAlarmDay(int hour, int minute);
 void updateAlarmDisplay();
 void checkAlarms();
 void handleTimerAlarm();
 
+// Buzzer tones
+void startTonePlayer();
+void playMelody(uint8_t melody, uint8_t repeats, uint8_t priority, uint8_t profile);
+void buildEnvelopes();
+void startSunrise();
+void armSunrise();
+void stopMelody(uint8_t priority);
+
 // Weather functions
 void fetchWeatherData();
 
@@ -40,6 +85,15 @@ void factoryReset();
 void loadConfiguration();
 void saveConfiguration();
 void saveAlarms();
+void loadTimers();
+void saveTimers();
+void flushTimers(bool force);
+void loadSnoozeConfig();
+void saveSnoozeConfig();
+void loadLcdConfig();
+void saveLcdConfig();
+void loadHolidays();
+void saveHolidays();
 void loadWeatherConfig();
 void saveWeatherConfig();
 
@@ -52,6 +106,12 @@ void handleButton();
 
 // Interrupt handling for immediate buzzer shutoff
 void IRAM_ATTR buttonInterrupt();
+void IRAM_ATTR encoderInterrupt();
+void startInputSampler();
+
+// Temperature
+bool startNtcAcquisition();
+void readTemperature();
 
 // Web interface
 String generateWebInterface();
@@ -69,6 +129,12 @@ void syncTimeWithNTP();
 #define BUTTON_PIN 26
 #define NTC_PIN 34
 
+// Menu controls: KY-040 style rotary encoder (push = OK) and a BACK button, all to GND
+#define ENCODER_A_PIN 18
+#define ENCODER_B_PIN 19
+#define SELECT_BUTTON_PIN 23
+#define BACK_BUTTON_PIN 27
+
 // Hardware Objects
 LiquidCrystal_I2C LCD(0x27, 16, 2);
 RTC_DS1307 rtc;
@@ -109,14 +175,125 @@ struct HardwareStatus
   String lastError = "";
 } hw;
 
-// Buzzer control variables for interrupt handling
-volatile bool buzzerStopRequested = false;
-volatile unsigned long lastInterruptTime = 0;
+// Inputs are sampled by a periodic esp_timer and debounced there (see INPUT SAMPLING);
+// the button ISR only keeps the buzzer kill fast path
+#define INPUT_SAMPLE_US 2000
+#define INPUT_DEBOUNCE_US (8 * INPUT_SAMPLE_US) // 3-bit vertical counter: 8 samples at the new level
+#define INPUT_MASK ((1UL << BUTTON_PIN) | (1UL << SELECT_BUTTON_PIN) | (1UL << BACK_BUTTON_PIN))
+#define BUTTON_DOUBLE_CLICK_MS 350
+#define BUTTON_LONG_PRESS_MS ALARM_DISMISS_HOLD_MS
+#define BUTTON_FACTORY_RESET_MS 5000
+static_assert(BUTTON_PIN < 32 && SELECT_BUTTON_PIN < 32 && BACK_BUTTON_PIN < 32 && ENCODER_A_PIN < 32 &&
+                  ENCODER_B_PIN < 32 && BUZZER_PIN < 32 && LED_PIN < 32,
+              "inputs and the kill path use the GPIO 0-31 registers");
+
+// Debounced levels of GPIO 0-31 (only INPUT_MASK bits are filtered), one word any task can read
+std::atomic<uint32_t> inputState{INPUT_MASK};
+esp_timer_handle_t inputSampler = nullptr;
+
+struct InputStats
+{
+  uint32_t samples = 0;
+  uint32_t changes = 0;
+  uint32_t maxSampleUs = 0; // longest sampler callback
+} inputStats;
+
+// Fast path in the ISR: a falling edge stops the buzzer and LED LEDC channels and mutes
+// the tone sequencer until the press is decoded
+volatile bool buzzerKilled = false;
+volatile uint32_t buzzerKillEdges = 0; // falling edges seen by the ISR
+
+struct BuzzerKillStats
+{
+  volatile uint32_t kills = 0; // presses that found the buzzer sounding
+  // In-ISR cost only: ISR entry -> LEDC outputs parked, on every real press
+  volatile uint32_t isrLastUs = 0;
+  volatile uint32_t isrMaxUs = 0;
+  // GPIO edge -> LEDC outputs parked, interrupt dispatch included. A real press has no
+  // timestamp, so this comes from measureBuzzerKill(), which makes the edge itself.
+  uint32_t edgeToSilenceNs = 0;
+  uint32_t edgeToSilenceMaxNs = 0;
+  uint32_t probes = 0;
+  uint32_t loopLatencyUs = 0; // press -> loop() handled BUTTON_DOWN, the old path
+  uint32_t loopLatencyMaxUs = 0;
+} buzzerKillStats;
+
+// The buzzer is fed by an LEDC channel; a one-shot esp_timer steps through the note
+// tables (see BUZZER MELODIES), so pitch and rhythm do not depend on loop()
+#define BUZZER_LEDC_CHANNEL 0 // high-speed group 0 on the ESP32
+#define BUZZER_LEDC_RESOLUTION 10
+#define BUZZER_FULL_DUTY (1 << (BUZZER_LEDC_RESOLUTION - 1)) // 50% square wave is the loudest
+#define LED_LEDC_CHANNEL 2 // channels 0/1 share the buzzer's timer, 2/3 get their own
+#define LED_LEDC_FREQ 5000
+#define LED_LEDC_RESOLUTION 12 // fine low end for the sunrise fade
+volatile bool toneSounding = false; // LEDC is driving the buzzer/LED: what the ISR has to cut
+uint16_t sunriseLevel = 0;          // LED level of the sunrise fade, shown between notes too
+
+// Rotary encoder: its A/B interrupts walk a Gray-code table and count quarter steps
+// into one atomic word (the ISRs are the only writer); loop() turns them into detents
+#define ENCODER_STEPS_PER_DETENT 4
+std::atomic<int32_t> encoderSteps{0};
+volatile uint8_t encoderPhase = 0; // last A/B levels
+
+enum InputId : uint8_t
+{
+  INPUT_MAIN,   // the original button: snooze, pages, factory reset
+  INPUT_SELECT, // encoder push: OK
+  INPUT_BACK,
+  BUTTON_COUNT,
+  INPUT_ENCODER = BUTTON_COUNT // rotation, not a button
+};
+
+enum ButtonGesture : uint8_t
+{
+  BUTTON_DOWN, // debounced press, before we know what it becomes
+  BUTTON_CLICK,
+  BUTTON_DOUBLE_CLICK,
+  BUTTON_LONG_PRESS,
+  BUTTON_VERY_LONG_PRESS, // factory reset
+  ENCODER_CW,             // one detent
+  ENCODER_CCW
+};
+
+struct ButtonEvent
+{
+  uint8_t input;
+  uint8_t gesture;
+  uint32_t heldMs;
+  int64_t edgeUs; // when the press started (BUTTON_DOWN)
+};
+
+QueueHandle_t buttonEvents = nullptr;
+
+// Gesture state of one button, advanced by the sampler
+struct ButtonDecoder
+{
+  uint8_t input;
+  uint8_t pin;
+  bool down;
+  int64_t pressUs;
+  bool clickPending; // one short press, waiting to see if a second follows
+  int64_t clickReleaseUs;
+};
+
+ButtonDecoder buttons[BUTTON_COUNT] = {
+    {INPUT_MAIN, BUTTON_PIN, false, 0, false, 0},
+    {INPUT_SELECT, SELECT_BUTTON_PIN, false, 0, false, 0},
+    {INPUT_BACK, BACK_BUTTON_PIN, false, 0, false, 0},
+};
+
+struct ButtonStats
+{
+  uint32_t gestures = 0;
+  uint32_t dropped = 0; // event queue full
+} buttonStats;
 
 // Temperature Data
 float currentTemp = 25.0;
 
 // Alarm System
+
+// New fields are appended only: saved records are loaded as a prefix of this struct
 struct Alarm
 {
   int hour = -1;
@@ -124,6 +301,14 @@ struct Alarm
   bool enabled = false;
   bool daysOfWeek[7] = {false};
   char label[32] = "";
+  uint8_t repeat = REPEAT_WEEKLY;
+  uint8_t nth = 1;
+  uint8_t weekday = 0; // 0 = Sunday
+  bool skipHolidays = false;
+  uint16_t interval = 1;
+  uint16_t startDay = 0; // Days since 2000-01-01
+  uint8_t melody = 0;    // MELODY_BEEP
+  uint8_t profile = 0;   // PROFILE_CLASSIC
 };
 
 #define MAX_ALARMS 5
@@ -132,18 +317,118 @@ int alarmCount = 0;
 bool alarmActive = false;
 int activeAlarmIndex = -1;
 
-// Countdown Timer
+// Snooze: short press re-arms the ringing alarm, long press dismisses it
+#define ALARM_DISMISS_HOLD_MS 1500
+#define ALARM_RING_TIMEOUT_MS (5UL * 60 * 1000) // PROFILE_CLASSIC; other profiles set their own
+#define ALARM_FIRE_GRACE_SEC 60
+
+struct SnoozeConfig
+{
+  int durationMinutes = 5;
+  int maxCount = 3;
+} snoozeConfig;
+
+struct SnoozeState
+{
+  uint32_t fireTime = 0; // RTC unix time of the pending re-fire, 0 = none
+  int alarmIndex = -1;
+  int count = 0; // Snoozes used by alarmIndex since it last rang on schedule
+} snooze;
+
+// Next fire instant across all alarms and the pending snooze (RTC unix time, 0 = none)
+uint32_t nextAlarmFireTime = 0;
+int nextAlarmFireIndex = -1;
+bool nextAlarmIsSnooze = false;
+
+// Countdown Timers
+#define MAX_TIMERS 4
+
+#define MAX_TIMER_PHASES 8
+
+// One step of a program (Pomodoro, HIIT, lab protocol); tone = beeps when the phase starts
+struct TimerPhase
+{
+  uint16_t seconds = 0;
+  uint8_t tone = 1;
+  char label[9] = "";
+};
+
 struct CountdownTimer
 {
-  unsigned long duration = 0; // in seconds
-  unsigned long startTime = 0;
+  unsigned long duration = 0; // in seconds, all rounds of a program
+  int64_t deadlineUs = 0;     // esp_timer_get_time() at the next expiry (phase end for programs)
+  uint32_t deadlineUnix = 0;  // RTC time at final expiry, what survives a reboot
   bool active = false;
-  bool finished = false;
   char label[32] = "Timer";
-  // Add alarm state for 5-second alert
-  bool alarmTriggered = false;
-  unsigned long alarmStartTime = 0;
-} timer;
+
+  // Program mode: phases run back to back without a web round-trip. Phase ends are
+  // precomputed offsets from startUs, so handling latency never accumulates as drift.
+  uint8_t phaseCount = 0; // 0 = plain countdown
+  uint8_t phase = 0;
+  uint8_t rounds = 1;
+  uint8_t round = 0;
+  int64_t startUs = 0;
+  uint32_t roundSeconds = 0;
+  uint32_t phaseEnd[MAX_TIMER_PHASES] = {0}; // Seconds from round start to the end of each phase
+  TimerPhase phases[MAX_TIMER_PHASES];
+};
+
+CountdownTimer timers[MAX_TIMERS];
+
+// Active timer indices as a binary min-heap on deadline: only timerHeap[0] is checked per tick
+uint8_t timerHeap[MAX_TIMERS];
+int timerHeapSize = 0;
+
+// One esp_timer one-shot armed for timerHeap[0]; its callback only posts a TimerEvent
+struct TimerEvent
+{
+  int64_t deadlineUs;
+  int64_t firedUs;
+};
+
+esp_timer_handle_t timerClock = nullptr;
+QueueHandle_t timerEvents = nullptr;
+portMUX_TYPE timerClockMux = portMUX_INITIALIZER_UNLOCKED;
+int64_t armedDeadlineUs = 0;
+
+// Expiry accuracy: callback lateness vs. deadline, and how long loop() took to act on it
+struct TimerJitterStats
+{
+  uint32_t samples = 0;
+  int32_t lastUs = 0;
+  int32_t maxUs = 0;
+  int64_t totalUs = 0;
+  int32_t lastHandleUs = 0;
+  int32_t maxHandleUs = 0;
+} timerJitter;
+
+// EEPROM record of a running timer. Only start/stop/expiry dirty the block and commits are
+// spaced TIMER_COMMIT_MIN_INTERVAL_MS apart, so a countdown never writes flash per tick.
+// New fields are appended only: saved records are loaded as a prefix of this struct
+struct SavedTimer
+{
+  uint32_t deadlineUnix = 0;
+  uint32_t duration = 0;
+  bool active = false;
+  char label[32] = "";
+  uint8_t phaseCount = 0;
+  uint8_t rounds = 1;
+  TimerPhase phases[MAX_TIMER_PHASES];
+};
+
+#define TIMER_COMMIT_MIN_INTERVAL_MS 10000
+#define TIMER_MISSED_ALERT_SEC 3600 // Timers that ran out while powered off still alert if this recent
+bool timersDirty = false;
+unsigned long lastTimerCommit = 0;
+uint32_t timerCommitCount = 0;
+
+// 5-second alert of the timer that expired last
+struct TimerAlert
+{
+  bool triggered = false;
+  unsigned long startTime = 0;
+  char label[32] = "";
+} timerAlert;
 
 // Weather Configuration
 struct WeatherConfig
@@ -183,14 +468,60 @@ const char *vietnamCities[][2] = {
 // LCD Display State
 String currentLCDLine1 = "";
 String currentLCDLine2 = "";
-int lcdDisplayMode = 0; // 0: Clock/Temp, 1: Weather
+int lcdDisplayMode = 0; // Position in lcdConfig.pageOrder
 unsigned long lastLCDModeChange = 0;
+bool pageForceRedraw = true; // set on page switches: render even if the data key is unchanged
+DateTime pageTime;           // RTC time read once per page refresh
+
+struct PageStats
+{
+  uint32_t renders = 0;
+  uint32_t skipped = 0; // refresh found the data key unchanged
+} pageStats;
+
+#define LCD_PAGE_COUNT (int)(sizeof(lcdPages) / sizeof(lcdPages[0]))
+
+// LiquidCrystal_I2C sends each HD44780 byte as 2 nibbles x 3 PCF8574 writes x (address + data)
+#define LCD_I2C_BYTES_PER_LCD_BYTE 12
+
+// The LCD pipeline (framebuffer, PCF8574 encoding, layers) is lib/LcdDisplay; this file
+// owns the bus it writes to
+#define LCD_I2C_ADDR 0x27
+#define LCD_I2C_CLOCK 400000 // PCF8574 fast mode
+#define RTC_I2C_CLOCK 100000 // DS1307 is a 100 kHz part
+uint32_t busClockHz = 0;
+SemaphoreHandle_t i2cBusMutex = NULL; // LCD task and RTC readers share the bus (and its clock)
+
+// Shared I2C bus occupancy, measured around the blocking Wire calls
+struct BusStats
+{
+  uint32_t lcdTransactions = 0;
+  uint32_t lcdI2cBytes = 0;
+  uint32_t lcdBusyUs = 0;
+  uint32_t lcdMaxTxUs = 0; // longest an RTC read can be held off by the LCD
+  uint32_t rtcReads = 0;
+  uint32_t rtcBusyUs = 0;
+  uint32_t lcdBusyUsPerSec = 0;
+  uint32_t rtcBusyUsPerSec = 0;
+  uint32_t lcdI2cBytesPerSec = 0;
+  uint32_t windowLcdBusyUs = 0;
+  uint32_t windowRtcBusyUs = 0;
+  uint32_t windowLcdI2cBytes = 0;
+} busStats;
+
+// Display task: owns the LCD, everybody else posts commands and never waits on I2C
+#define DISPLAY_QUEUE_LEN 8
+#define DISPLAY_POST_WAIT_MS 50 // overlays and clears are state changes: wait for room this long
+QueueHandle_t displayQueue = NULL;
+TaskHandle_t displayTaskHandle = NULL;
 
 // Constants
-#define EEPROM_SIZE 1024
+#define EEPROM_SIZE 2048
 #define CONFIG_ADDR 0
 #define ALARM_ADDR 400
 #define TIMER_ADDR 800
+static_assert(4 + MAX_ALARMS * sizeof(Alarm) <= TIMER_ADDR - ALARM_ADDR, "alarms overflow EEPROM block");
+static_assert(TIMER_ADDR + 4 + MAX_TIMERS * sizeof(SavedTimer) <= EEPROM_SIZE, "timers overflow EEPROM block");
 bool rtcSynced = false; // True if RTC has been synced with NTP
 bool webServerStarted = false;
 
@@ -217,7 +548,7 @@ void clearAllData()
   Serial.println("Clearing all stored data...");
 
   // Clear EEPROM
-  for (int i = 0; i < 512; i++)
+  for (int i = 0; i < EEPROM_SIZE; i++)
   {
     EEPROM.write(i, 0);
   }
@@ -230,8 +561,12 @@ void clearAllData()
 
   // Reset variables
   alarmCount = 0;
-  timer.active = false;
-  timer.duration = 0;
+  for (int i = 0; i < MAX_TIMERS; i++)
+  {
+    timers[i] = CountdownTimer();
+  }
+  timerHeapSize = 0;
+  armTimerClock();
   strcpy(config.deviceName, "SmartClock-v5");
   strcpy(config.hotspotSSID, "SmartClock-v5");
   strcpy(config.hotspotPassword, "smartclock123");
@@ -239,28 +574,16 @@ void clearAllData()
   Serial.println("All data cleared!");
 }
 
+// ==========================================
+// NTC CONVERSION
+// ==========================================
+// Wokwi's NTC module (and the usual breakout): a 10k Beta 3950 NTC against a 10k
+// resistor. lib/NtcTable turns the Beta equation into a compile-time table, so a reading
+// is one lookup and a linear interpolation, with no log() and no float division.
+
 float convertAdcToTemperature(int adcValue)
 {
-  // Convert ADC reading to temperature for LM35 sensor
-  // LM35: 10mV/°C, linear output
-  if (adcValue == 0)
-    return 25.0; // Default temperature
-
-  // Convert ADC to voltage (ESP32: 12-bit ADC, 3.3V reference)
-  float voltage = (adcValue / 4095.0) * 3.3;
-
-  // LM35: 10mV per degree Celsius
-  // Temperature = Voltage / 0.01V per °C
-  float tempC = voltage / 0.01;
-
-  // Reasonable range check for LM35 (-55°C to +150°C, but typically 2°C to 100°C)
-  if (tempC < -10 || tempC > 100)
-  {
-    Serial.println("Warning: Temperature out of range: " + String(tempC) + "°C");
-    return 25.0; // Return default if out of range
-  }
-
-  return tempC;
+  return ntcCentiCelsius(adcValue) * 0.01f;
 }
 
 void factoryReset()
@@ -306,20 +629,13 @@ void initializeHardware()
   Wire.begin();
   LCD.init();
   LCD.backlight();
-  LCD.clear();
-  LCD.setCursor(0, 0);
-  LCD.print("Smart Clock v5.0");
-  LCD.setCursor(0, 1);
-  LCD.print("Standalone Mode");
+  lcdClear();
+  updateLCDContent("Smart Clock v5.0", "Standalone Mode");
   hw.lcdOK = true;
 
-  if (rtc.begin())
+  if (rtcBegin(true))
   {
     hw.rtcOK = true;
-    if (!rtc.isrunning())
-    {
-      rtc.adjust(DateTime(F(__DATE__), F(__TIME__)));
-    }
   }
   else
   {
@@ -344,12 +660,197 @@ void initializeHardware()
   Serial.println("=== HARDWARE INIT COMPLETE ===");
 }
 
+// Both the LCD backpack and the DS1307 live on the same bus at different speeds
+void setBusClock(uint32_t hz)
+{
+  if (busClockHz == hz)
+    return;
+  Wire.setClock(hz);
+  busClockHz = hz;
+}
+
+DateTime readRtc()
+{
+  if (i2cBusMutex)
+    xSemaphoreTake(i2cBusMutex, portMAX_DELAY);
+  setBusClock(RTC_I2C_CLOCK);
+  unsigned long t0 = micros();
+  DateTime now = rtc.now();
+  uint32_t busy = micros() - t0;
+  if (i2cBusMutex)
+    xSemaphoreGive(i2cBusMutex);
+  busStats.rtcReads++;
+  busStats.rtcBusyUs += busy;
+  busStats.windowRtcBusyUs += busy;
+  return now;
+}
+
+// Same locking as readRtc(): once the display task runs, an unlocked RTC access can
+// land in the middle of an LCD transaction at the wrong bus clock
+bool rtcBegin(bool startIfHalted)
+{
+  if (i2cBusMutex)
+    xSemaphoreTake(i2cBusMutex, portMAX_DELAY);
+  setBusClock(RTC_I2C_CLOCK);
+  bool ok = rtc.begin();
+  if (ok && startIfHalted && !rtc.isrunning())
+    rtc.adjust(DateTime(F(__DATE__), F(__TIME__)));
+  if (i2cBusMutex)
+    xSemaphoreGive(i2cBusMutex);
+  return ok;
+}
+
+void rtcAdjust(const DateTime &time)
+{
+  if (i2cBusMutex)
+    xSemaphoreTake(i2cBusMutex, portMAX_DELAY);
+  setBusClock(RTC_I2C_CLOCK);
+  rtc.adjust(time);
+  if (i2cBusMutex)
+    xSemaphoreGive(i2cBusMutex);
+}
+
+// ==========================================
+// TEMPERATURE ACQUISITION
+// ==========================================
+// NTC_PIN (GPIO34 = ADC1 channel 6) is sampled through the ADC's continuous (DMA) mode
+// in short bursts. ntcTask takes the median of each burst, which throws out the spikes
+// the ESP32 ADC is known for, then calibrates it with esp_adc_cal and smooths it with a
+// fixed-point EMA. loop() only reads the result, and analogRead() must not touch ADC1
+// while this runs.
+
+#define NTC_ADC_CHANNEL ADC1_CHANNEL_6
+static_assert(NTC_PIN == 34, "NTC_ADC_CHANNEL must follow NTC_PIN");
+#define NTC_SAMPLE_HZ 20000   // lowest continuous-mode rate on the ESP32
+#define NTC_BURST_SAMPLES 128 // one DMA frame: 6.4 ms of samples
+#define NTC_BURST_PERIOD_MS 250
+#define NTC_EMA_SHIFT 3       // alpha 1/8: ~2 s time constant at 4 bursts/s
+#define NTC_FULL_SCALE_MV 3300
+
+// The continuous-mode driver of IDF 4.4 (Arduino-ESP32 2.0.x, pinned in platformio.ini).
+// Its ESP32 results are TYPE1 words with no SOC_ caps for their size, as in the IDF's
+// own dma_read example, so the layout is spelled out here.
+#define NTC_RESULT_BYTES 2 // adc_digi_output_data_t: 12-bit data + 4-bit channel
+#define NTC_BIT_WIDTH 12
+static_assert(sizeof(adc_digi_output_data_t) == NTC_RESULT_BYTES, "ESP32 TYPE1 results are 16 bits");
+
+struct NtcStats
+{
+  uint32_t bursts = 0;
+  uint32_t samples = 0;
+  uint32_t overruns = 0;   // DMA store buffer filled between bursts (old samples dropped)
+  uint16_t lastMedian = 0; // raw code
+  uint32_t maxBurstUs = 0;
+} ntcStats;
+
+esp_adc_cal_characteristics_t ntcAdcChars;
+std::atomic<uint32_t> ntcMillivolts{0}; // filtered and calibrated, 0 = no reading yet
+uint32_t ntcEma = 0;                      // mV << NTC_EMA_SHIFT, owned by ntcTask
+TaskHandle_t ntcTaskHandle = nullptr;
+
+// Collect one burst and fold its median into the EMA; false if the ADC returned nothing
+bool ntcBurst()
+{
+  static uint8_t frame[NTC_BURST_SAMPLES * NTC_RESULT_BYTES];
+  static uint16_t codes[NTC_BURST_SAMPLES];
+  int64_t t0 = esp_timer_get_time();
+  int count = 0;
+
+  adc_digi_start();
+  while (count < NTC_BURST_SAMPLES)
+  {
+    uint32_t length = 0;
+    esp_err_t err = adc_digi_read_bytes(frame, sizeof(frame), &length, 50);
+    if (err == ESP_ERR_INVALID_STATE)
+      ntcStats.overruns++; // the bytes returned are still good
+    else if (err != ESP_OK)
+      break;
+    for (uint32_t i = 0; i + NTC_RESULT_BYTES <= length && count < NTC_BURST_SAMPLES; i += NTC_RESULT_BYTES)
+    {
+      const adc_digi_output_data_t *sample = (const adc_digi_output_data_t *)&frame[i];
+      if (sample->type1.channel == NTC_ADC_CHANNEL)
+        codes[count++] = sample->type1.data;
+    }
+  }
+  adc_digi_stop();
+  if (count == 0)
+    return false;
+
+  std::nth_element(codes, codes + count / 2, codes + count);
+  uint16_t median = codes[count / 2];
+  uint32_t mv = esp_adc_cal_raw_to_voltage(median, &ntcAdcChars);
+  ntcEma = ntcEma == 0 ? mv << NTC_EMA_SHIFT : ntcEma + mv - (ntcEma >> NTC_EMA_SHIFT);
+  ntcMillivolts.store(ntcEma >> NTC_EMA_SHIFT, std::memory_order_release);
+
+  // Rails mean an open or shorted divider
+  hw.tempOK = median > 0 && median < 4095;
+  ntcStats.lastMedian = median;
+  ntcStats.bursts++;
+  ntcStats.samples += count;
+  uint32_t took = esp_timer_get_time() - t0;
+  if (took > ntcStats.maxBurstUs)
+    ntcStats.maxBurstUs = took;
+  return true;
+}
+
+void ntcTask(void *)
+{
+  TickType_t wake = xTaskGetTickCount();
+  for (;;)
+  {
+    ntcBurst();
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(NTC_BURST_PERIOD_MS));
+  }
+}
+
+bool startNtcAcquisition()
+{
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = 4 * NTC_BURST_SAMPLES * NTC_RESULT_BYTES;
+  init.conv_num_each_intr = NTC_BURST_SAMPLES * NTC_RESULT_BYTES;
+  init.adc1_chan_mask = BIT(NTC_ADC_CHANNEL);
+  init.adc2_chan_mask = 0;
+
+  adc_digi_pattern_config_t pattern = {};
+  pattern.atten = ADC_ATTEN_DB_11;
+  pattern.channel = NTC_ADC_CHANNEL;
+  pattern.unit = 0; // ADC1
+  pattern.bit_width = NTC_BIT_WIDTH;
+
+  adc_digi_configuration_t config = {};
+  config.conv_limit_en = true; // required on the ESP32
+  config.conv_limit_num = 250;
+  config.pattern_num = 1;
+  config.adc_pattern = &pattern;
+  config.sample_freq_hz = NTC_SAMPLE_HZ;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+
+  if (adc_digi_initialize(&init) != ESP_OK || adc_digi_controller_configure(&config) != ESP_OK)
+  {
+    Serial.println("✗ ADC continuous mode unavailable");
+    return false;
+  }
+  esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &ntcAdcChars);
+
+  // First burst here so setup() has a reading, then the task takes over
+  ntcBurst();
+  xTaskCreatePinnedToCore(ntcTask, "ntc", 3072, NULL, 1, &ntcTaskHandle, 0);
+  return true;
+}
+
+// Filtered reading as the 12-bit code of an ideal 0-3.3 V ADC
+int ntcAdcCode()
+{
+  uint32_t code = ntcMillivolts.load(std::memory_order_acquire) * 4095 / NTC_FULL_SCALE_MV;
+  return code > 4095 ? 4095 : code;
+}
+
 void readTemperature()
 {
   if (!hw.tempOK)
     return;
-  int adcValue = analogRead(NTC_PIN);
-  currentTemp = convertAdcToTemperature(adcValue);
+  currentTemp = convertAdcToTemperature(ntcAdcCode());
 }
 
 // ==========================================
@@ -358,321 +859,2203 @@ void readTemperature()
 // Switch LCD display mode
 void switchLcdDisplayMode()
 {
-  lcdDisplayMode = (lcdDisplayMode + 1) % 2; // or % N if you have more modes
+  lcdDisplayMode = (lcdDisplayMode + 1) % lcdConfig.pageCount;
   lastLCDModeChange = millis();
-  displayClock();
+  pageForceRedraw = true;
+  displayPages();
 }
 
-void updateLCDContent(String line1, String line2)
+// False when the frame could not be queued; the cache is left alone so the next call resends it
+bool updateLCDContent(String line1, String line2)
 {
   if (line1 != currentLCDLine1 || line2 != currentLCDLine2)
   {
-    currentLCDLine1 = line1;
-    currentLCDLine2 = line2;
-
-    LCD.clear();
-    LCD.setCursor(0, 0);
-    LCD.print(line1.substring(0, 16));
-    LCD.setCursor(0, 1);
-    LCD.print(line2.substring(0, 16));
+    // Old renderer: clear + 2 x (setCursor + 16 chars) on every change
+    uint32_t legacy = 1 + 2 + (line1.length() < LCD_COLS ? line1.length() : LCD_COLS) +
+                      (line2.length() < LCD_COLS ? line2.length() : LCD_COLS);
+    lcdStats.legacyBytes += legacy;
+    lcdStats.windowLegacyBytes += legacy;
+  }
+  else
+  {
+    return true; // Nothing new for the display task
   }
+  if (!postDisplayLines(line1.c_str(), line2.c_str(), GLYPHS_ANY))
+    return false;
+  currentLCDLine1 = line1;
+  currentLCDLine2 = line2;
+  return true;
 }
 
-void displayClock()
+// A NULL line leaves that row to the layers below
+bool postDisplayLayer(uint8_t layer, const char *line1, const char *line2, uint8_t glyphs, uint16_t blinkMs, uint16_t ttlMs)
 {
-  static unsigned long lastUpdate = 0;
-  unsigned long now = millis();
-
-  // Switch display mode every 60 seconds
-  if (now - lastLCDModeChange > 60000)
+  DisplayCommand cmd = {DISPLAY_SET_LAYER, layer, 0, glyphs, blinkMs, ttlMs, "", ""};
+  if (line1)
   {
-    lcdDisplayMode = (lcdDisplayMode + 1) % 2;
-    lastLCDModeChange = now;
+    utf8Copy(cmd.line1, sizeof(cmd.line1), line1, LCD_TEXT_MAX);
+    cmd.rowMask |= 1;
+  }
+  if (line2)
+  {
+    utf8Copy(cmd.line2, sizeof(cmd.line2), line2, LCD_TEXT_MAX);
+    cmd.rowMask |= 2;
   }
+  return postDisplayCommand(cmd);
+}
 
-  if (now - lastUpdate < 1000)
-    return;
-  lastUpdate = now;
+bool postDisplayLines(const char *line1, const char *line2, uint8_t glyphs)
+{
+  return postDisplayLayer(LAYER_BASE, line1, line2, glyphs, 0, 0);
+}
 
-  DateTime rtcNow = rtc.now();
+bool displayOverlay(uint8_t layer, const char *line1, const char *line2, uint16_t blinkMs)
+{
+  return postDisplayLayer(layer, line1, line2, GLYPHS_ANY, blinkMs, 0);
+}
 
-  if (lcdDisplayMode == 0)
-  {
-    // Mode 0: Clock + Temperature
-    char line1[17];
-    snprintf(line1, sizeof(line1), "%02d:%02d:%02d %4.1fC",
-             rtcNow.hour(), rtcNow.minute(), rtcNow.second(), currentTemp);
+bool displayClearOverlay(uint8_t layer)
+{
+  DisplayCommand cmd = {DISPLAY_CLEAR_LAYER, layer, 0, GLYPHS_ANY, 0, 0, "", ""};
+  return postDisplayCommand(cmd);
+}
+
+// Short message over the current screen, gone after ttlMs
+void displayNotice(const char *line1, const char *line2, uint16_t ttlMs)
+{
+  postDisplayLayer(LAYER_NOTICE, line1, line2, GLYPHS_ANY, 0, ttlMs);
+}
+
+// LcdDisplay hooks: the display task's writes, on the shared bus at the LCD's clock
+void lcdBusWrite(const uint8_t *bytes, int count)
+{
+  if (i2cBusMutex)
+    xSemaphoreTake(i2cBusMutex, portMAX_DELAY);
+  setBusClock(LCD_I2C_CLOCK);
+  unsigned long t0 = micros();
+  Wire.beginTransmission(LCD_I2C_ADDR);
+  Wire.write(bytes, count);
+  Wire.endTransmission();
+  uint32_t busy = micros() - t0;
+  if (i2cBusMutex)
+    xSemaphoreGive(i2cBusMutex);
+
+  busStats.lcdTransactions++;
+  busStats.lcdI2cBytes += count + 1;
+  busStats.windowLcdI2cBytes += count + 1;
+  busStats.lcdBusyUs += busy;
+  busStats.windowLcdBusyUs += busy;
+  if (busy > busStats.lcdMaxTxUs)
+    busStats.lcdMaxTxUs = busy;
+}
+
+void lcdBusClear()
+{
+  if (i2cBusMutex)
+    xSemaphoreTake(i2cBusMutex, portMAX_DELAY);
+  setBusClock(LCD_I2C_CLOCK);
+  LCD.clear();
+  if (i2cBusMutex)
+    xSemaphoreGive(i2cBusMutex);
+}
 
-    char line2[17];
-    String status = hw.wifiOK ? "WIFI" : "DISC";
-    if (alarmCount > 0)
-      status = "A" + String(alarmCount);
-    if (timer.active)
-      status = "TIMER";
+unsigned long lcdMillis()
+{
+  return millis();
+}
 
-    snprintf(line2, sizeof(line2), "%02d/%02d/%02d %s",
-             rtcNow.day(), rtcNow.month(), rtcNow.year() % 100, status.c_str());
+// Roll the per-second traffic counters
+void updateLcdStats()
+{
+  unsigned long now = millis();
+  if (now - lcdStats.windowStart < 1000)
+    return;
+  unsigned long elapsed = now - lcdStats.windowStart;
+  lcdStats.bytesPerSec = lcdStats.windowBytes * 1000UL / elapsed;
+  lcdStats.legacyBytesPerSec = lcdStats.windowLegacyBytes * 1000UL / elapsed;
+  lcdStats.windowBytes = 0;
+  lcdStats.windowLegacyBytes = 0;
+  lcdStats.windowStart = now;
+
+  busStats.lcdBusyUsPerSec = busStats.windowLcdBusyUs * 1000UL / elapsed;
+  busStats.rtcBusyUsPerSec = busStats.windowRtcBusyUs * 1000UL / elapsed;
+  busStats.lcdI2cBytesPerSec = busStats.windowLcdI2cBytes * 1000UL / elapsed;
+  busStats.windowLcdBusyUs = 0;
+  busStats.windowRtcBusyUs = 0;
+  busStats.windowLcdI2cBytes = 0;
+}
 
-    updateLCDContent(String(line1), String(line2));
+// Base frames never block: on a full queue they are dropped and the caller, whose cache
+// did not move, sends them again. Overlays and clears are edges nobody repeats, so they
+// wait a little for the display task to drain the queue. False = the command was lost.
+bool postDisplayCommand(const DisplayCommand &cmd)
+{
+  if (!displayQueue)
+  {
+    // Before the task starts (hardware bring-up), draw synchronously
+    applyDisplayCommand(cmd);
+    renderDisplay();
+    return true;
   }
-  else
+  TickType_t wait = cmd.type == DISPLAY_CLEAR_LAYER || cmd.layer != LAYER_BASE ? pdMS_TO_TICKS(DISPLAY_POST_WAIT_MS) : 0;
+  if (xQueueSend(displayQueue, &cmd, wait) != pdTRUE)
   {
-    // Mode 1: Weather Information
-    char line1[17];
-    char line2[17];
+    displayStats.dropped++;
+    return false;
+  }
+  return true;
+}
 
-    if (weather.dataValid)
+void displayTask(void *param)
+{
+  DisplayState &d = displayState;
+  for (;;)
+  {
+    // Sleep until a command, the next blink edge, marquee step, notice expiry or stats window
+    unsigned long wait = expireDisplayLayers(stepMarquees(1000));
+    if (d.blinkLayer != LAYER_NONE)
     {
-      snprintf(line1, sizeof(line1), "%s: %.1fC",
-               weather.city.substring(0, 8).c_str(), weather.temperature);
-      snprintf(line2, sizeof(line2), "%s: %d%%",
-               "Humidity", weather.humidity);
+      long untilBlink = (long)(d.nextBlink - millis());
+      if (untilBlink <= 0)
+        wait = 0;
+      else if ((unsigned long)untilBlink < wait)
+        wait = untilBlink;
     }
-    else
+
+    DisplayCommand cmd;
+    if (xQueueReceive(displayQueue, &cmd, pdMS_TO_TICKS(wait)) == pdTRUE)
     {
-      strcpy(line1, "Weather");
-      strcpy(line2, "No data...");
+      applyDisplayCommand(cmd);
+      displayStats.commands++;
+      // Coalesce everything already queued into the same frame
+      while (xQueueReceive(displayQueue, &cmd, 0) == pdTRUE)
+      {
+        applyDisplayCommand(cmd);
+        displayStats.commands++;
+        displayStats.coalesced++;
+      }
     }
 
-    updateLCDContent(String(line1), String(line2));
+    expireDisplayLayers(0);
+    stepDisplayBlink();
+    renderDisplay();
+    updateLcdStats();
   }
 }
 
-void displayCountdown()
+void startDisplayTask()
 {
-  if (!timer.active)
-    return;
-
-  unsigned long elapsed = (millis() - timer.startTime) / 1000;
-  if (elapsed >= timer.duration)
-  {
-    // Timer finished - trigger 5-second alarm
-    timer.active = false;
-    timer.finished = true;
-    timer.alarmTriggered = true;
-    timer.alarmStartTime = millis();
-    Serial.println("=== COUNTDOWN FINISHED - 5 SECOND ALARM ===");
-    return;
-  }
-
-  unsigned long remaining = timer.duration - elapsed;
-  int minutes = remaining / 60;
-  int seconds = remaining % 60;
-
-  char line1[17];
-  snprintf(line1, sizeof(line1), "TIMER: %02d:%02d", minutes, seconds);
-
-  updateLCDContent(String(line1), String(timer.label));
+  i2cBusMutex = xSemaphoreCreateMutex();
+  displayQueue = xQueueCreate(DISPLAY_QUEUE_LEN, sizeof(DisplayCommand));
+  xTaskCreatePinnedToCore(displayTask, "display", 3072, NULL, 1, &displayTaskHandle, 1);
 }
 
 // ==========================================
-// ENHANCED ALARM & TIMER SYSTEM
+// LCD PAGES
 // ==========================================
+// Each page declares how often it wants to be looked at and a data key that changes
+// whenever its content would; the engine only renders (and posts) when the key moved.
 
-void triggerAlarm(int index)
+uint32_t pageKey(uint32_t a, uint32_t b)
 {
-  activeAlarmIndex = index;
-  alarmActive = true;
-  timer.finished = false; // Reset timer finished flag
-  currentState = STATE_ALARM;
-  stateStartTime = millis();
+  return a * 31 + b;
 }
 
-void stopAlarm()
+// Clock + temperature
+uint32_t clockPageKey()
 {
-  alarmActive = false;
-  timer.active = false;
-  timer.finished = false;
-  digitalWrite(BUZZER_PIN, LOW);
-  digitalWrite(LED_PIN, LOW);
-  currentState = STATE_NORMAL;
-  activeAlarmIndex = -1;
+  uint32_t key = pageKey(pageTime.unixtime(), (int)(currentTemp * 10));
+  return pageKey(key, (hw.wifiOK ? 1 : 0) + alarmCount * 2 + (timerHeapSize > 0 ? 64 : 0));
 }
 
-void updateAlarmDisplay()
+uint8_t renderClockPage(char *line1, char *line2)
 {
-  static unsigned long lastBlink = 0;
-  static bool blinkState = false;
+  String status = hw.wifiOK ? "WIFI" : "DISC";
+  if (alarmCount > 0)
+    status = "A" + String(alarmCount);
+  if (timerHeapSize > 0)
+    status = "TIMER";
 
-  if (millis() - lastBlink > 500)
-  {
-    lastBlink = millis();
-    blinkState = !blinkState;
+  return formatClockLines(line1, line2, pageTime.hour(), pageTime.minute(), pageTime.second(),
+                          pageTime.day(), pageTime.month(), pageTime.year(), currentTemp, status.c_str());
+}
 
-    if (blinkState)
-    {
-      String label = "WAKE UP!";
-      if (activeAlarmIndex >= 0)
-      {
-        label = alarms[activeAlarmIndex].label;
-      }
-      else if (timer.finished)
-      {
-        label = timer.label;
-      }
+// Weather: city + temperature, humidity + description (scrolls when long)
+uint32_t weatherPageKey()
+{
+  return pageKey(weather.lastUpdate, weather.dataValid);
+}
 
-      updateLCDContent("*** ALARM ***", label);
-      digitalWrite(BUZZER_PIN, HIGH);
-      digitalWrite(LED_PIN, HIGH);
-    }
-    else
-    {
-      LCD.clear();
-      currentLCDLine1 = "";
-      currentLCDLine2 = "";
-      digitalWrite(BUZZER_PIN, LOW);
-      digitalWrite(LED_PIN, LOW);
-    }
+uint8_t renderWeatherPage(char *line1, char *line2)
+{
+  if (weather.dataValid)
+  {
+    char city[LCD_TEXT_MAX + 1];
+    utf8Copy(city, sizeof(city), weather.city.c_str(), 8); // 8 characters, not bytes ("Hà Nội" is 9 bytes)
+    snprintf(line1, LCD_TEXT_MAX + 1, "%s: %.1fC", city, weather.temperature);
+    snprintf(line2, LCD_TEXT_MAX + 1, "%d%% %s", weather.humidity, weather.description.c_str());
   }
-
-  // Auto-stop after 5 minutes (300 seconds)
-  if (millis() - stateStartTime > 5 * 60 * 1000)
+  else
   {
-    stopAlarm();
+    strcpy(line1, "Weather");
+    strcpy(line2, "No data...");
   }
+  return GLYPHS_ANY;
 }
 
-// ==========================================
-// BUTTON HANDLING
-// ==========================================
-void handleButton()
+// HH:MM in big digits, readable across the room
+uint32_t bigClockPageKey()
 {
-  static unsigned long lastPress = 0;
-  static bool lastState = HIGH;
-  static unsigned long pressStartTime = 0;
-
-  // Check if interrupt handler requested buzzer stop
-  if (buzzerStopRequested)
-  {
-    buzzerStopRequested = false;
+  return pageKey(pageTime.hour() * 60 + pageTime.minute(), pageTime.second() % 2);
+}
 
-    // Handle the alarm state change
-    if (currentState == STATE_ALARM || alarmActive)
-    {
-      stopAlarm();
-      Serial.println("Alarm stopped by interrupt");
-    }
+uint8_t renderBigClockPage(char *line1, char *line2)
+{
+  return formatBigClockLines(line1, line2, pageTime.hour(), pageTime.minute(), pageTime.second());
+}
 
-    // Stop timer alarm if active
-    if (timer.alarmTriggered)
-    {
-      timer.alarmTriggered = false;
-      timer.finished = false;
-      Serial.println("Timer alarm stopped by interrupt");
-    }
+// Next alarm (or snooze) from the scheduler, with the time left
+uint32_t nextAlarmPageKey()
+{
+  uint32_t minutesLeft = nextAlarmFireTime > pageTime.unixtime() ? (nextAlarmFireTime - pageTime.unixtime()) / 60 : 0;
+  return pageKey(pageKey(nextAlarmFireTime, nextAlarmFireIndex), minutesLeft);
+}
 
-    return; // Exit early if interrupt handled the buzzer
+uint8_t renderNextAlarmPage(char *line1, char *line2)
+{
+  if (nextAlarmFireTime == 0 || nextAlarmFireIndex < 0)
+  {
+    strcpy(line1, "Next alarm");
+    strcpy(line2, "None");
+    return GLYPHS_ANY;
   }
 
-  bool buttonState = digitalRead(BUTTON_PIN);
+  static const char *dayNames[7] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+  DateTime fire(nextAlarmFireTime);
+  snprintf(line1, LCD_TEXT_MAX + 1, "%s %s %02d:%02d", nextAlarmIsSnooze ? "Snooze" : "Alarm",
+           dayNames[fire.dayOfTheWeek()], fire.hour(), fire.minute());
 
-  // Immediate buzzer shutoff check (non-interrupt backup)
-  if (buttonState == LOW)
-  {
-    // If buzzer is currently ON, turn it off immediately
-    if (digitalRead(BUZZER_PIN) == HIGH)
-    {
-      digitalWrite(BUZZER_PIN, LOW);
-      digitalWrite(LED_PIN, LOW);
+  uint32_t minutesLeft = nextAlarmFireTime > pageTime.unixtime() ? (nextAlarmFireTime - pageTime.unixtime() + 59) / 60 : 0;
+  if (minutesLeft >= 24 * 60)
+    snprintf(line2, LCD_TEXT_MAX + 1, "in %lud %s", (unsigned long)(minutesLeft / (24 * 60)), alarms[nextAlarmFireIndex].label);
+  else
+    snprintf(line2, LCD_TEXT_MAX + 1, "in %luh%02lu %s", (unsigned long)(minutesLeft / 60), (unsigned long)(minutesLeft % 60),
+             alarms[nextAlarmFireIndex].label);
+  return GLYPHS_ANY;
+}
 
-      if (currentState == STATE_ALARM || alarmActive)
-      {
-        stopAlarm();
-        Serial.println("Alarm stopped by button press");
-        return;
-      }
+// Indoor (NTC) vs outdoor (weather) temperature
+uint32_t comparePageKey()
+{
+  return pageKey(pageKey((int)(currentTemp * 10), (int)(weather.temperature * 10)), weather.dataValid);
+}
 
-      if (timer.alarmTriggered)
-      {
-        timer.alarmTriggered = false;
-        timer.finished = false;
-        Serial.println("Timer alarm stopped by button press");
-        return;
-      }
-    }
-  }
+uint8_t renderComparePage(char *line1, char *line2)
+{
+  snprintf(line1, LCD_TEXT_MAX + 1, "In  %5.1fC", currentTemp);
+  if (weather.dataValid)
+    snprintf(line2, LCD_TEXT_MAX + 1, "Out %5.1fC %+.1f", weather.temperature, weather.temperature - currentTemp);
+  else
+    strcpy(line2, "Out    --");
+  return GLYPHS_ANY;
+}
 
-  // Standard debounced button handling
-  if (buttonState != lastState && millis() - lastPress > 50)
-  {
-    lastPress = millis();
+// Network: IP and signal in station mode, the hotspot otherwise
+uint32_t networkPageKey()
+{
+  if (WiFi.status() != WL_CONNECTED)
+    return 1;
+  return pageKey((uint32_t)WiFi.localIP(), WiFi.RSSI() / 5);
+}
 
-    if (buttonState == LOW)
-    {
-      pressStartTime = millis();
+uint8_t renderNetworkPage(char *line1, char *line2)
+{
+  if (WiFi.status() == WL_CONNECTED)
+  {
+    snprintf(line1, LCD_TEXT_MAX + 1, "%s", WiFi.localIP().toString().c_str());
+    snprintf(line2, LCD_TEXT_MAX + 1, "%s %ddBm", WiFi.SSID().c_str(), (int)WiFi.RSSI());
+  }
+  else
+  {
+    snprintf(line1, LCD_TEXT_MAX + 1, "AP %s", config.hotspotSSID);
+    strcpy(line2, "192.168.4.1");
+  }
+  return GLYPHS_ANY;
+}
+
+struct LcdPage
+{
+  const char *id;    // used by the web API
+  const char *title; // shown on the web page
+  uint16_t refreshMs;
+  bool needsTime; // reads the RTC into pageTime before the key
+  uint32_t (*dataKey)();
+  uint8_t (*render)(char *line1, char *line2); // returns the CGRAM set it needs
+};
+
+const LcdPage lcdPages[] = {
+    {"clock", "Đồng hồ", 1000, true, clockPageKey, renderClockPage},
+    {"weather", "Thời tiết", 1000, false, weatherPageKey, renderWeatherPage},
+    {"bigclock", "Số lớn", 500, true, bigClockPageKey, renderBigClockPage},
+    {"alarm", "Báo thức kế tiếp", 1000, true, nextAlarmPageKey, renderNextAlarmPage},
+    {"compare", "Trong/ngoài nhà", 2000, false, comparePageKey, renderComparePage},
+    {"network", "Mạng", 5000, false, networkPageKey, renderNetworkPage},
+};
+static_assert(sizeof(lcdPages) / sizeof(lcdPages[0]) <= MAX_LCD_PAGES, "raise MAX_LCD_PAGES");
+
+int findLcdPage(const char *id)
+{
+  for (int i = 0; i < LCD_PAGE_COUNT; i++)
+    if (!strcmp(lcdPages[i].id, id))
+      return i;
+  return -1;
+}
+
+// "clock,weather,bigclock" -> target's rotation; unknown ids are skipped. False if nothing
+// was valid, and target is left alone.
+bool parseLcdPageOrder(const String &text, LcdConfig &target)
+{
+  uint8_t order[MAX_LCD_PAGES];
+  int count = 0;
+  int start = 0;
+  while (start <= (int)text.length() && count < MAX_LCD_PAGES)
+  {
+    int end = text.indexOf(',', start);
+    if (end < 0)
+      end = text.length();
+    String id = text.substring(start, end);
+    id.trim();
+    start = end + 1;
+
+    int page = findLcdPage(id.c_str());
+    if (page >= 0)
+      order[count++] = page;
+  }
+  if (count == 0)
+    return false;
+
+  memcpy(target.pageOrder, order, count);
+  target.pageCount = count;
+  return true;
+}
+
+String lcdPageOrderString()
+{
+  String text;
+  for (int i = 0; i < lcdConfig.pageCount; i++)
+  {
+    if (i > 0)
+      text += ",";
+    text += lcdPages[lcdConfig.pageOrder[i]].id;
+  }
+  return text;
+}
+
+const LcdPage &currentLcdPage()
+{
+  return lcdPages[lcdConfig.pageOrder[lcdDisplayMode % lcdConfig.pageCount]];
+}
+
+// Page engine: rotate on the dwell time, poll the current page at its own rate and
+// only post a frame when its data key changed
+void displayPages()
+{
+  static unsigned long lastRefresh = 0;
+  static uint32_t lastKey = 0;
+  unsigned long now = millis();
+
+  if (lcdConfig.dwellSeconds > 0 && now - lastLCDModeChange > lcdConfig.dwellSeconds * 1000UL)
+  {
+    lcdDisplayMode = (lcdDisplayMode + 1) % lcdConfig.pageCount;
+    lastLCDModeChange = now;
+    pageForceRedraw = true;
+  }
+
+  const LcdPage &page = currentLcdPage();
+  if (!pageForceRedraw && now - lastRefresh < page.refreshMs)
+    return;
+  lastRefresh = now;
+
+  if (page.needsTime)
+    pageTime = readRtc();
+  uint32_t key = page.dataKey();
+  if (!pageForceRedraw && key == lastKey)
+  {
+    pageStats.skipped++;
+    return;
+  }
+  pageStats.renders++;
+
+  char line1[LCD_TEXT_MAX + 1];
+  char line2[LCD_TEXT_MAX + 1];
+  uint8_t glyphs = page.render(line1, line2);
+  if (glyphs == GLYPHS_ANY)
+  {
+    if (!updateLCDContent(String(line1), String(line2)))
+      return; // queue full: the key did not move, so the next refresh tries again
+  }
+  else
+  {
+    if (!postDisplayLines(line1, line2, glyphs))
+      return;
+    // Lines are glyph codes: keep a readable copy for the web page
+    currentLCDLine1 = String("[") + page.id + "]";
+    currentLCDLine2 = "";
+  }
+  pageForceRedraw = false;
+  lastKey = key;
+}
+
+// Soonest-expiring timer on line 1 (with how many others run), its label on line 2
+void displayCountdown()
+{
+  static bool shown = false;
+  static char lastLine1[17] = "";
+  static char lastLine2[LCD_TEXT_MAX + 1] = "";
+  if (timerHeapSize == 0)
+  {
+    if (shown && displayClearOverlay(LAYER_COUNTDOWN)) // the page underneath was kept up to date
+      shown = false;
+    return;
+  }
+
+  const CountdownTimer &soonest = timers[timerHeap[0]];
+  char line1[17];
+  formatCountdownLine(line1, sizeof(line1), timerRemaining(timerHeap[0]), timerHeapSize - 1);
+
+  char line2[LCD_TEXT_MAX + 1]; // long labels scroll
+  if (soonest.phaseCount > 0)
+    snprintf(line2, sizeof(line2), "%-8s %d/%d", soonest.phases[soonest.phase].label, soonest.round + 1, soonest.rounds);
+  else
+    snprintf(line2, sizeof(line2), "%s", soonest.label);
+
+  if (shown && !strcmp(line1, lastLine1) && !strcmp(line2, lastLine2))
+    return;
+  if (!displayOverlay(LAYER_COUNTDOWN, line1, line2, 0))
+    return;
+  strcpy(lastLine1, line1);
+  strcpy(lastLine2, line2);
+  shown = true;
+}
+
+// ==========================================
+// ALARM RECURRENCE RULES
+// ==========================================
+// Day math and the rule engine live in lib/AlarmRules; this binds them to alarms[].
+
+CompiledRule alarmRules[MAX_ALARMS];
+
+// "YYYY-MM-DD" (HTML date input) -> day number, RULE_NO_DAY if invalid
+uint32_t parseDateArg(const String &text)
+{
+  int year, month, dayOfMonth;
+  if (sscanf(text.c_str(), "%d-%d-%d", &year, &month, &dayOfMonth) != 3)
+    return RULE_NO_DAY;
+  if (year < 2000 || year > 2150 || month < 1 || month > 12 || dayOfMonth < 1 || dayOfMonth > daysInMonth(year, month))
+    return RULE_NO_DAY;
+  return dayFromDate(year, month, dayOfMonth);
+}
+
+// Today, or tomorrow if hh:mm already passed
+uint16_t nextAlarmDay(int hour, int minute)
+{
+  uint32_t since2000 = readRtc().unixtime() - EPOCH_2000_UNIX;
+  return since2000 / 86400 + ((hour * 60 + minute) * 60UL <= since2000 % 86400 ? 1 : 0);
+}
+
+String formatDayNumber(uint32_t day, bool iso = false)
+{
+  int year, month, dayOfMonth;
+  dateFromDay(day, year, month, dayOfMonth);
+  char text[11];
+  if (iso)
+    snprintf(text, sizeof(text), "%04d-%02d-%02d", year, month, dayOfMonth);
+  else
+    snprintf(text, sizeof(text), "%02d/%02d/%04d", dayOfMonth, month, year);
+  return String(text);
+}
+
+CompiledRule compileAlarmRule(const Alarm &alarm)
+{
+  CompiledRule rule;
+  rule.kind = alarm.repeat;
+  rule.minuteOfDay = alarm.hour * 60 + alarm.minute;
+  rule.skipHolidays = alarm.skipHolidays;
+  rule.anchorDay = alarm.startDay;
+  rule.interval = alarm.interval > 0 ? alarm.interval : 1;
+  rule.nth = constrain(alarm.nth, 1, 5);
+  rule.weekday = alarm.weekday % 7;
+  for (int d = 0; d < 7; d++)
+  {
+    if (alarm.daysOfWeek[d])
+      rule.weekMask |= 1 << d;
+  }
+  return rule;
+}
+
+void compileAlarmRules()
+{
+  for (int i = 0; i < alarmCount; i++)
+  {
+    alarmRules[i] = compileAlarmRule(alarms[i]);
+  }
+}
+
+// ==========================================
+// ALARM SCHEDULER
+// ==========================================
+
+// Recompute the single next fire instant; checkAlarms() then only compares one value per tick
+void scheduleAlarms(uint32_t from)
+{
+  nextAlarmFireTime = 0;
+  nextAlarmFireIndex = -1;
+  nextAlarmIsSnooze = false;
+
+  for (int i = 0; i < alarmCount; i++)
+  {
+    if (!alarms[i].enabled)
+      continue;
+    uint32_t fire = nextRuleOccurrence(alarmRules[i], from);
+    if (fire != 0 && (nextAlarmFireTime == 0 || fire < nextAlarmFireTime))
+    {
+      nextAlarmFireTime = fire;
+      nextAlarmFireIndex = i;
+    }
+  }
+
+  // The snooze is just a one-shot entry competing for the same slot
+  if (snooze.fireTime != 0 && (nextAlarmFireTime == 0 || snooze.fireTime <= nextAlarmFireTime))
+  {
+    nextAlarmFireTime = snooze.fireTime;
+    nextAlarmFireIndex = snooze.alarmIndex;
+    nextAlarmIsSnooze = true;
+  }
+
+  armSunrise();
+}
+
+// ==========================================
+// BUZZER MELODIES
+// ==========================================
+// A melody is a table of {Hz, ms} notes (0 Hz = rest). The one-shot toneTimer is the only
+// code that touches the LEDC channel: each callback sounds one note and re-arms itself
+// for that note's end, so nothing runs between notes and the rhythm ignores loop() load.
+// loop() only leaves a request behind and kicks the timer.
+
+struct Note
+{
+  uint16_t hz;
+  uint16_t ms;
+};
+
+const Note melodyBeep[] = {{2000, 500}, {0, 500}};
+const Note melodyDouble[] = {{2000, 120}, {0, 80}, {2000, 120}, {0, 680}};
+const Note melodyRising[] = {{1047, 150}, {1319, 150}, {1568, 150}, {2093, 300}, {0, 450}};
+const Note melodyChirp[] = {{2637, 60}, {0, 40}, {3136, 60}, {0, 40}, {2637, 60}, {0, 740}};
+const Note melodyTimer[] = {{2000, 250}, {0, 250}};
+const Note melodyChime[] = {{1568, 120}, {0, 120}};
+
+struct Melody
+{
+  const char *name;
+  const Note *notes;
+  uint8_t count;
+};
+
+#define MELODY(name, notes) {name, notes, sizeof(notes) / sizeof(notes[0])}
+
+// The first ALARM_MELODY_COUNT entries can be picked per alarm (Alarm::melody)
+enum MelodyId : uint8_t
+{
+  MELODY_BEEP,
+  MELODY_DOUBLE,
+  MELODY_RISING,
+  MELODY_CHIRP,
+  ALARM_MELODY_COUNT,
+  MELODY_TIMER = ALARM_MELODY_COUNT,
+  MELODY_CHIME,
+  MELODY_COUNT
+};
+
+const Melody melodies[MELODY_COUNT] = {
+    MELODY("Beep", melodyBeep),
+    MELODY("Double beep", melodyDouble),
+    MELODY("Rising", melodyRising),
+    MELODY("Chirp", melodyChirp),
+    MELODY("Timer", melodyTimer),
+    MELODY("Chime", melodyChime),
+};
+
+// A request only replaces a melody of the same or lower priority
+enum TonePriority : uint8_t
+{
+  TONE_CHIME, // program phase changes
+  TONE_TIMER, // expired countdown
+  TONE_ALARM
+};
+
+// Intensity profiles: loudness (buzzer duty), the gaps between beeps and LED brightness
+// climb from a start level to full over rampSec, then hold until ringSec snoozes the
+// alarm. buildEnvelopes() expands them once into ENVELOPE_STEPS levels, so the player
+// only indexes a table per note.
+struct IntensityProfile
+{
+  const char *name;
+  uint16_t rampSec;
+  uint16_t ringSec;    // alarm auto-snooze
+  uint8_t startPct;    // loudness and LED at t = 0
+  uint16_t startGapPct; // rests stretched to this at t = 0 (100 = as written)
+  bool led;
+};
+
+enum ToneProfile : uint8_t
+{
+  PROFILE_CLASSIC,
+  PROFILE_GENTLE,
+  PROFILE_ESCALATING,
+  ALARM_PROFILE_COUNT,
+  PROFILE_CHIME = ALARM_PROFILE_COUNT, // full volume, LED stays dark
+  PROFILE_COUNT
+};
+
+const IntensityProfile intensityProfiles[PROFILE_COUNT] = {
+    {"Classic", 0, ALARM_RING_TIMEOUT_MS / 1000, 100, 100, true},
+    {"Gentle", 300, 600, 15, 400, true},
+    {"Escalating", 90, 300, 40, 250, true},
+    {"Chime", 0, 0, 100, 100, false},
+};
+
+#define ENVELOPE_STEPS 16
+
+struct EnvelopeStep
+{
+  uint16_t duty; // buzzer, of 1 << BUZZER_LEDC_RESOLUTION
+  uint16_t led;  // of 1 << LED_LEDC_RESOLUTION
+  uint16_t gapPct;
+};
+
+EnvelopeStep envelopes[PROFILE_COUNT][ENVELOPE_STEPS];
+
+// Loudness and brightness follow the square of the level so equal steps sound and look
+// roughly even; the gaps shrink linearly
+void buildEnvelopes()
+{
+  for (int p = 0; p < PROFILE_COUNT; p++)
+  {
+    const IntensityProfile &profile = intensityProfiles[p];
+    for (int i = 0; i < ENVELOPE_STEPS; i++)
+    {
+      uint32_t pct = profile.startPct + (100 - profile.startPct) * i / (ENVELOPE_STEPS - 1);
+      EnvelopeStep &step = envelopes[p][i];
+      step.duty = BUZZER_FULL_DUTY * pct * pct / 10000;
+      step.led = profile.led ? ((1 << LED_LEDC_RESOLUTION) - 1) * pct * pct / 10000 : 0;
+      step.gapPct = profile.startGapPct - (int)(profile.startGapPct - 100) * i / (ENVELOPE_STEPS - 1);
+    }
+  }
+}
+
+const EnvelopeStep &envelopeAt(uint8_t profile, int64_t elapsedUs)
+{
+  uint32_t rampUs = intensityProfiles[profile].rampSec * 1000000UL;
+  int step = ENVELOPE_STEPS - 1;
+  if (elapsedUs < (int64_t)rampUs)
+    step = elapsedUs * (ENVELOPE_STEPS - 1) / rampUs;
+  return envelopes[profile][step];
+}
+
+unsigned long alarmRingTimeoutMs(int index)
+{
+  uint8_t profile = index >= 0 && index < alarmCount && alarms[index].profile < ALARM_PROFILE_COUNT
+                        ? alarms[index].profile
+                        : PROFILE_CLASSIC;
+  return intensityProfiles[profile].ringSec * 1000UL;
+}
+
+struct ToneRequest
+{
+  bool pending = false;
+  bool stop = false;
+  uint8_t melody = 0;
+  uint8_t repeats = 0; // 0 = until stopped
+  uint8_t priority = 0;
+  uint8_t profile = 0;
+};
+
+// Owned by the toneTimer callback
+struct TonePlayer
+{
+  const Note *notes = nullptr; // nullptr = silent
+  uint8_t count = 0;
+  uint8_t index = 0;
+  uint8_t repeatsLeft = 0; // 0 = loop forever
+  uint8_t priority = 0;
+  uint8_t profile = 0;
+  int64_t startUs = 0; // envelope time zero
+  int64_t noteEndUs = 0;
+} tonePlayer;
+
+esp_timer_handle_t toneTimer = nullptr;
+portMUX_TYPE toneMux = portMUX_INITIALIZER_UNLOCKED;
+ToneRequest toneRequest;
+uint32_t toneNotes = 0; // notes started, for /status
+uint16_t toneDuty = 0;  // duty of the last note, for /status
+
+// The LED lights with each note (if the profile uses it) and falls back to the sunrise
+// level on rests
+void sendTone(uint16_t hz, const EnvelopeStep &level, bool led)
+{
+  // A button press mutes whatever is playing; the melody keeps its place and resumes
+  // on the next note if the sampler decides the edge was noise
+  if (buzzerKilled)
+    hz = 0;
+  if (hz > 0)
+  {
+    ledcSetup(BUZZER_LEDC_CHANNEL, hz, BUZZER_LEDC_RESOLUTION);
+    ledcWrite(BUZZER_LEDC_CHANNEL, level.duty);
+    if (led)
+      ledcWrite(LED_LEDC_CHANNEL, level.led);
+  }
+  else
+  {
+    ledcWrite(BUZZER_LEDC_CHANNEL, 0);
+    if (led)
+      ledcWrite(LED_LEDC_CHANNEL, sunriseLevel);
+  }
+  toneDuty = hz > 0 ? level.duty : 0;
+  toneSounding = hz > 0;
+}
+
+void silenceTone()
+{
+  tonePlayer.notes = nullptr;
+  sendTone(0, envelopes[PROFILE_CHIME][0], intensityProfiles[tonePlayer.profile].led);
+}
+
+void onToneTimer(void *)
+{
+  portENTER_CRITICAL(&toneMux);
+  ToneRequest request = toneRequest;
+  toneRequest.pending = false;
+  portEXIT_CRITICAL(&toneMux);
+
+  int64_t now = esp_timer_get_time();
+  TonePlayer &p = tonePlayer;
+  bool outranked = p.notes != nullptr && request.priority < p.priority;
+  if (request.pending && !outranked)
+  {
+    if (request.stop)
+    {
+      silenceTone();
+      return;
+    }
+    const Melody &m = melodies[request.melody < MELODY_COUNT ? request.melody : MELODY_BEEP];
+    p.notes = m.notes;
+    p.count = m.count;
+    p.index = 0;
+    p.repeatsLeft = request.repeats;
+    p.priority = request.priority;
+    p.profile = request.profile < PROFILE_COUNT ? request.profile : PROFILE_CLASSIC;
+    p.startUs = now;
+    p.noteEndUs = now;
+  }
+  else
+  {
+    if (p.notes == nullptr)
+      return;
+    if (now < p.noteEndUs)
+    {
+      // Woken early by a request that did not apply: finish the current note
+      esp_timer_start_once(toneTimer, p.noteEndUs - now);
+      return;
+    }
+    if (++p.index >= p.count)
+    {
+      p.index = 0;
+      if (p.repeatsLeft > 0 && --p.repeatsLeft == 0)
+      {
+        silenceTone();
+        return;
+      }
+    }
+  }
+
+  // Next boundary counts from the previous one, so late callbacks do not stretch the tune.
+  // The envelope only widens rests: beeps keep their length, the rate climbs.
+  const Note &note = p.notes[p.index];
+  const EnvelopeStep &level = envelopeAt(p.profile, now - p.startUs);
+  uint32_t ms = note.hz > 0 ? note.ms : note.ms * level.gapPct / 100;
+  p.noteEndUs += ms * 1000LL;
+  if (p.noteEndUs <= now)
+    p.noteEndUs = now + 1000;
+  sendTone(note.hz, level, intensityProfiles[p.profile].led);
+  toneNotes++;
+  esp_timer_start_once(toneTimer, p.noteEndUs - now);
+}
+
+void postToneRequest(const ToneRequest &request)
+{
+  if (toneTimer == nullptr)
+    return;
+
+  portENTER_CRITICAL(&toneMux);
+  // Two requests before the callback ran: the lower one loses
+  if (!toneRequest.pending || request.priority >= toneRequest.priority)
+    toneRequest = request;
+  portEXIT_CRITICAL(&toneMux);
+
+  esp_timer_stop(toneTimer);
+  esp_timer_start_once(toneTimer, 0);
+}
+
+void playMelody(uint8_t melody, uint8_t repeats, uint8_t priority, uint8_t profile)
+{
+  ToneRequest request;
+  request.pending = true;
+  request.melody = melody;
+  request.repeats = repeats;
+  request.priority = priority;
+  request.profile = profile;
+  postToneRequest(request);
+}
+
+// Silence the melody if it was started at this priority or below
+void stopMelody(uint8_t priority)
+{
+  ToneRequest request;
+  request.pending = true;
+  request.stop = true;
+  request.priority = priority;
+  postToneRequest(request);
+}
+
+void startTonePlayer()
+{
+  buildEnvelopes();
+  ledcSetup(BUZZER_LEDC_CHANNEL, 2000, BUZZER_LEDC_RESOLUTION);
+  ledcAttachPin(BUZZER_PIN, BUZZER_LEDC_CHANNEL);
+  ledcWrite(BUZZER_LEDC_CHANNEL, 0);
+  ledcSetup(LED_LEDC_CHANNEL, LED_LEDC_FREQ, LED_LEDC_RESOLUTION);
+  ledcAttachPin(LED_PIN, LED_LEDC_CHANNEL);
+  ledcWrite(LED_LEDC_CHANNEL, 0);
+
+  esp_timer_create_args_t args = {};
+  args.callback = onToneTimer;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "tone";
+  if (esp_timer_create(&args, &toneTimer) != ESP_OK)
+  {
+    toneTimer = nullptr;
+    Serial.println("✗ Tone esp_timer unavailable, buzzer disabled");
+  }
+}
+
+// ==========================================
+// SUNRISE LIGHT
+// ==========================================
+// The LED fades in over sunriseConfig.minutes before the next scheduled alarm. The fade
+// walks SUNRISE_STEPS perceptually even levels from a gamma table built once at boot,
+// so a step is a table read and one ledcWrite. Like the tone player, a one-shot
+// esp_timer owns the fade and re-arms itself for the next step boundary; loop() only
+// hands it a new target whenever scheduleAlarms() moves nextAlarmFireTime.
+
+#define SUNRISE_STEPS 256
+#define SUNRISE_GAMMA 2.2f
+
+struct SunriseConfig
+{
+  int minutes = 10; // 0 = off
+} sunriseConfig;
+
+// Fade window in esp_timer time, both 0 = no fade
+struct SunriseTarget
+{
+  int64_t startUs;
+  int64_t fireUs;
+};
+
+uint16_t sunriseGamma[SUNRISE_STEPS];
+esp_timer_handle_t sunriseTimer = nullptr;
+portMUX_TYPE sunriseMux = portMUX_INITIALIZER_UNLOCKED;
+SunriseTarget sunriseTarget = {0, 0};
+
+void buildSunriseGamma()
+{
+  const uint16_t full = (1 << LED_LEDC_RESOLUTION) - 1;
+  for (int i = 0; i < SUNRISE_STEPS; i++)
+    sunriseGamma[i] = (uint16_t)(powf(i / (float)(SUNRISE_STEPS - 1), SUNRISE_GAMMA) * full + 0.5f);
+}
+
+void writeSunrise(uint16_t level)
+{
+  if (level == sunriseLevel)
+    return;
+  sunriseLevel = level;
+  // A ringing alarm or timer alert lights the LED with its notes; don't fight it
+  if (tonePlayer.notes == nullptr || !intensityProfiles[tonePlayer.profile].led)
+    ledcWrite(LED_LEDC_CHANNEL, level);
+}
+
+void onSunriseTimer(void *)
+{
+  portENTER_CRITICAL(&sunriseMux);
+  SunriseTarget target = sunriseTarget;
+  portEXIT_CRITICAL(&sunriseMux);
+
+  int64_t now = esp_timer_get_time();
+  if (target.fireUs == 0 || now < target.startUs)
+  {
+    writeSunrise(0);
+    if (target.fireUs != 0)
+      esp_timer_start_once(sunriseTimer, target.startUs - now);
+    return;
+  }
+  if (now >= target.fireUs)
+  {
+    // Hold full brightness until the alarm fires and scheduleAlarms() moves the target
+    writeSunrise(sunriseGamma[SUNRISE_STEPS - 1]);
+    return;
+  }
+
+  int64_t window = target.fireUs - target.startUs;
+  int step = (now - target.startUs) * SUNRISE_STEPS / window;
+  writeSunrise(sunriseGamma[step]);
+
+  // First instant that maps to step + 1
+  int64_t nextUs = target.startUs + ((step + 1) * window + SUNRISE_STEPS - 1) / SUNRISE_STEPS;
+  esp_timer_start_once(sunriseTimer, nextUs > now ? nextUs - now : 1);
+}
+
+// Point the fade at nextAlarmFireTime (snooze re-fires get no sunrise)
+void armSunrise()
+{
+  if (sunriseTimer == nullptr)
+    return;
+
+  SunriseTarget target = {0, 0};
+  if (sunriseConfig.minutes > 0 && nextAlarmFireTime != 0 && !nextAlarmIsSnooze)
+  {
+    int64_t now = esp_timer_get_time();
+    int64_t untilFire = (int64_t)nextAlarmFireTime - (int64_t)readRtc().unixtime();
+    target.fireUs = now + untilFire * 1000000LL;
+    target.startUs = target.fireUs - sunriseConfig.minutes * 60000000LL;
+  }
+
+  portENTER_CRITICAL(&sunriseMux);
+  sunriseTarget = target;
+  portEXIT_CRITICAL(&sunriseMux);
+
+  esp_timer_stop(sunriseTimer);
+  esp_timer_start_once(sunriseTimer, 0);
+}
+
+void startSunrise()
+{
+  buildSunriseGamma();
+
+  esp_timer_create_args_t args = {};
+  args.callback = onSunriseTimer;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "sunrise";
+  if (esp_timer_create(&args, &sunriseTimer) != ESP_OK)
+  {
+    sunriseTimer = nullptr;
+    Serial.println("✗ Sunrise esp_timer unavailable, no wake-up light");
+  }
+}
+
+// ==========================================
+// ENHANCED ALARM & TIMER SYSTEM
+// ==========================================
+
+void triggerAlarm(int index)
+{
+  activeAlarmIndex = index;
+  alarmActive = true;
+  currentState = STATE_ALARM;
+  stateStartTime = millis();
+  buzzerKilled = false; // a mute left over from an earlier press must not swallow this alarm
+  if (index >= 0 && index < alarmCount)
+    playMelody(alarms[index].melody, 0, TONE_ALARM, alarms[index].profile);
+  else
+    playMelody(MELODY_BEEP, 0, TONE_ALARM, PROFILE_CLASSIC);
+}
+
+void stopAlarm()
+{
+  alarmActive = false;
+  displayClearOverlay(LAYER_ALARM);
+  stopMelody(TONE_ALARM);
+  currentState = timerHeapSize > 0 ? STATE_COUNTDOWN : STATE_NORMAL;
+  activeAlarmIndex = -1;
+}
+
+// Silence the ringing alarm and re-arm it snoozeConfig.durationMinutes from now
+void snoozeAlarm()
+{
+  if (activeAlarmIndex < 0 || snoozeConfig.maxCount <= 0)
+  {
+    dismissAlarm();
+    return;
+  }
+
+  if (snooze.alarmIndex != activeAlarmIndex)
+    snooze.count = 0;
+
+  if (snooze.count >= snoozeConfig.maxCount)
+  {
+    Serial.println("Snooze limit reached, dismissing alarm");
+    dismissAlarm();
+    return;
+  }
+
+  uint32_t now = readRtc().unixtime();
+  snooze.alarmIndex = activeAlarmIndex;
+  snooze.fireTime = now + snoozeConfig.durationMinutes * 60UL;
+  snooze.count++;
+  Serial.printf("Alarm snoozed %d/%d for %d min\n", snooze.count, snoozeConfig.maxCount, snoozeConfig.durationMinutes);
+  char notice[17];
+  snprintf(notice, sizeof(notice), "%d min (%d/%d)", snoozeConfig.durationMinutes, snooze.count, snoozeConfig.maxCount);
+
+  stopAlarm();
+  displayNotice("Snoozed", notice, 3000);
+  scheduleAlarms(now + 1);
+}
+
+// Stop the ringing alarm for good and drop any pending snooze
+void dismissAlarm()
+{
+  snooze.fireTime = 0;
+  snooze.alarmIndex = -1;
+  snooze.count = 0;
+  stopAlarm();
+  displayNotice("Alarm off", NULL, 2000);
+  scheduleAlarms(readRtc().unixtime() + 1);
+  Serial.println("Alarm dismissed");
+}
+
+void deleteAlarm(int index)
+{
+  if (index < 0 || index >= alarmCount)
+    return;
+  for (int i = index; i < alarmCount - 1; i++)
+    alarms[i] = alarms[i + 1];
+  alarmCount--;
+  saveAlarms();
+
+  // Keep a pending snooze pointing at the same alarm after the shift
+  if (snooze.alarmIndex == index)
+  {
+    snooze.fireTime = 0;
+    snooze.alarmIndex = -1;
+    snooze.count = 0;
+  }
+  else if (snooze.alarmIndex > index)
+  {
+    snooze.alarmIndex--;
+  }
+  scheduleAlarms(readRtc().unixtime());
+}
+
+// ==========================================
+// COUNTDOWN TIMER POOL
+// ==========================================
+
+bool timerDeadlineBefore(int a, int b)
+{
+  return timers[a].deadlineUs < timers[b].deadlineUs;
+}
+
+void timerHeapSwap(int a, int b)
+{
+  uint8_t tmp = timerHeap[a];
+  timerHeap[a] = timerHeap[b];
+  timerHeap[b] = tmp;
+}
+
+void timerHeapSiftUp(int pos)
+{
+  while (pos > 0)
+  {
+    int parent = (pos - 1) / 2;
+    if (!timerDeadlineBefore(timerHeap[pos], timerHeap[parent]))
+      break;
+    timerHeapSwap(pos, parent);
+    pos = parent;
+  }
+}
+
+void timerHeapSiftDown(int pos)
+{
+  while (true)
+  {
+    int smallest = pos;
+    int left = 2 * pos + 1;
+    int right = left + 1;
+    if (left < timerHeapSize && timerDeadlineBefore(timerHeap[left], timerHeap[smallest]))
+      smallest = left;
+    if (right < timerHeapSize && timerDeadlineBefore(timerHeap[right], timerHeap[smallest]))
+      smallest = right;
+    if (smallest == pos)
+      break;
+    timerHeapSwap(pos, smallest);
+    pos = smallest;
+  }
+}
+
+void timerHeapRemoveAt(int pos)
+{
+  timerHeap[pos] = timerHeap[--timerHeapSize];
+  if (pos < timerHeapSize)
+  {
+    timerHeapSiftDown(pos);
+    timerHeapSiftUp(pos);
+  }
+}
+
+unsigned long timerRemaining(int index)
+{
+  int64_t remainingUs = timers[index].deadlineUs - esp_timer_get_time();
+  return remainingUs > 0 ? (remainingUs + 999999) / 1000000 : 0;
+}
+
+// Runs in the esp_timer task: stamp the expiry and wake loop(), nothing else
+void onTimerClock(void *)
+{
+  TimerEvent event;
+  event.firedUs = esp_timer_get_time();
+  portENTER_CRITICAL(&timerClockMux);
+  event.deadlineUs = armedDeadlineUs;
+  portEXIT_CRITICAL(&timerClockMux);
+  xQueueSend(timerEvents, &event, 0);
+}
+
+void setupTimerClock()
+{
+  timerEvents = xQueueCreate(MAX_TIMERS * 2, sizeof(TimerEvent));
+
+  esp_timer_create_args_t args = {};
+  args.callback = onTimerClock;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "countdown";
+  if (timerEvents == nullptr || esp_timer_create(&args, &timerClock) != ESP_OK)
+  {
+    timerClock = nullptr;
+    Serial.println("✗ Countdown esp_timer unavailable, falling back to loop polling");
+  }
+}
+
+// Re-arm the one-shot for the current heap top (call after any heap change)
+void armTimerClock()
+{
+  if (timerClock == nullptr)
+    return;
+
+  esp_timer_stop(timerClock);
+  if (timerHeapSize == 0)
+    return;
+
+  int64_t deadline = timers[timerHeap[0]].deadlineUs;
+  portENTER_CRITICAL(&timerClockMux);
+  armedDeadlineUs = deadline;
+  portEXIT_CRITICAL(&timerClockMux);
+
+  int64_t delayUs = deadline - esp_timer_get_time();
+  esp_timer_start_once(timerClock, delayUs > 0 ? delayUs : 1);
+}
+
+// Place a program timer at `elapsedSeconds` into its run: round, phase and next deadline
+void seekTimerPhase(CountdownTimer &t, uint32_t elapsedSeconds)
+{
+  t.round = elapsedSeconds / t.roundSeconds;
+  uint32_t offset = elapsedSeconds % t.roundSeconds;
+  t.phase = 0;
+  while (t.phase < t.phaseCount - 1 && t.phaseEnd[t.phase] <= offset)
+    t.phase++;
+  t.deadlineUs = t.startUs + (t.round * (int64_t)t.roundSeconds + t.phaseEnd[t.phase]) * 1000000LL;
+}
+
+// Move to the next phase, false once the last round is over
+bool advanceTimerPhase(CountdownTimer &t)
+{
+  if (++t.phase >= t.phaseCount)
+  {
+    t.phase = 0;
+    if (++t.round >= t.rounds)
+      return false;
+  }
+  t.deadlineUs = t.startUs + (t.round * (int64_t)t.roundSeconds + t.phaseEnd[t.phase]) * 1000000LL;
+  return true;
+}
+
+// Put a timer in a free slot, `elapsedSeconds` into its run (non-zero when resuming).
+// Returns its index or -1 if the pool is full.
+int addTimer(const CountdownTimer &setup, uint32_t elapsedSeconds)
+{
+  for (int i = 0; i < MAX_TIMERS; i++)
+  {
+    if (timers[i].active)
+      continue;
+
+    CountdownTimer &t = timers[i];
+    t = setup;
+    t.active = true;
+    t.startUs = esp_timer_get_time() - elapsedSeconds * 1000000LL;
+
+    if (t.phaseCount > 0)
+    {
+      t.roundSeconds = 0;
+      for (int p = 0; p < t.phaseCount; p++)
+      {
+        t.roundSeconds += t.phases[p].seconds;
+        t.phaseEnd[p] = t.roundSeconds;
+      }
+      // A program whose phases add up to nothing cannot be seeked: run it as a plain countdown
+      if (t.roundSeconds == 0)
+        t.phaseCount = 0;
+    }
+
+    if (t.phaseCount > 0)
+    {
+      t.duration = t.roundSeconds * t.rounds;
+      seekTimerPhase(t, elapsedSeconds);
+    }
+    else
+    {
+      t.deadlineUs = t.startUs + t.duration * 1000000LL;
+    }
+
+    timerHeap[timerHeapSize] = i;
+    timerHeapSiftUp(timerHeapSize++);
+    armTimerClock();
+
+    if (currentState == STATE_NORMAL)
+      currentState = STATE_COUNTDOWN;
+    return i;
+  }
+  return -1;
+}
+
+int startTimer(unsigned long durationSeconds, const char *label)
+{
+  CountdownTimer setup;
+  setup.duration = durationSeconds;
+  setup.deadlineUnix = readRtc().unixtime() + durationSeconds;
+  if (label && label[0])
+    strncpy(setup.label, label, sizeof(setup.label) - 1);
+
+  int index = addTimer(setup, 0);
+  if (index >= 0)
+    timersDirty = true;
+  return index;
+}
+
+int startProgram(const TimerPhase *phases, int phaseCount, int rounds, const char *label)
+{
+  CountdownTimer setup;
+  setup.phaseCount = constrain(phaseCount, 1, MAX_TIMER_PHASES);
+  setup.rounds = constrain(rounds, 1, 99);
+  uint32_t roundSeconds = 0;
+  for (int p = 0; p < setup.phaseCount; p++)
+  {
+    setup.phases[p] = phases[p];
+    roundSeconds += phases[p].seconds;
+  }
+  if (roundSeconds == 0)
+    return -1;
+  setup.deadlineUnix = readRtc().unixtime() + roundSeconds * setup.rounds;
+  if (label && label[0])
+    strncpy(setup.label, label, sizeof(setup.label) - 1);
+
+  int index = addTimer(setup, 0);
+  if (index >= 0)
+  {
+    timersDirty = true;
+    if (setup.phases[0].tone > 0)
+      playMelody(MELODY_CHIME, setup.phases[0].tone, TONE_CHIME, PROFILE_CHIME);
+  }
+  return index;
+}
+
+// "25m:Work:1, 5m:Break:2" -> phases. Duration takes s/m/h, bare numbers are minutes;
+// label and tone (beep count 0-3) are optional. Returns the phase count, 0 if any item
+// is malformed or there are more than MAX_TIMER_PHASES.
+int parseTimerPhases(const String &text, TimerPhase *phases)
+{
+  int count = 0;
+  int start = 0;
+  while (start < (int)text.length())
+  {
+    if (count == MAX_TIMER_PHASES)
+      return 0;
+    int end = text.indexOf(',', start);
+    if (end < 0)
+      end = text.length();
+    String item = text.substring(start, end);
+    start = end + 1;
+
+    char unit = 'm';
+    char name[sizeof(phases[0].label)] = "";
+    int value = 0, tone = 1;
+    const char *p = item.c_str();
+    while (*p == ' ')
+      p++;
+    if (sscanf(p, "%d", &value) != 1 || value <= 0)
+      return 0;
+    while (*p >= '0' && *p <= '9')
+      p++;
+    if (*p == 's' || *p == 'm' || *p == 'h')
+      unit = *p++;
+    if (*p == ':')
+    {
+      p++;
+      int n = 0;
+      while (*p && *p != ':' && n < (int)sizeof(name) - 1)
+        name[n++] = *p++;
+      name[n] = '\0';
+      while (*p && *p != ':')
+        p++;
+      if (*p == ':')
+      {
+        p++;
+        if (*p < '0' || *p > '3')
+          return 0;
+        tone = *p++ - '0';
+      }
+    }
+    while (*p == ' ')
+      p++;
+    if (*p != '\0')
+      return 0; // e.g. "25x" or "5m:Break:1x"
+
+    uint32_t seconds = value * (unit == 'h' ? 3600UL : unit == 'm' ? 60UL : 1UL);
+    if (seconds > 65535)
+      return 0;
+    phases[count].seconds = seconds;
+    phases[count].tone = tone;
+    strncpy(phases[count].label, name, sizeof(phases[count].label) - 1);
+    count++;
+  }
+  return count;
+}
+
+void stopTimer(int index)
+{
+  if (index < 0 || index >= MAX_TIMERS || !timers[index].active)
+    return;
+
+  timers[index].active = false;
+  timersDirty = true;
+  for (int pos = 0; pos < timerHeapSize; pos++)
+  {
+    if (timerHeap[pos] == index)
+    {
+      timerHeapRemoveAt(pos);
+      armTimerClock();
+      break;
     }
-    else
+  }
+}
+
+// Drain expiry events from the esp_timer callback and expire every timer that is due.
+// Without events (or without the esp_timer) this is a single comparison on the heap top.
+void checkTimers()
+{
+  TimerEvent event;
+  while (timerEvents != nullptr && xQueueReceive(timerEvents, &event, 0) == pdTRUE)
+  {
+    int32_t lateUs = event.firedUs - event.deadlineUs;
+    int32_t handleUs = esp_timer_get_time() - event.firedUs;
+    timerJitter.samples++;
+    timerJitter.lastUs = lateUs;
+    timerJitter.totalUs += lateUs;
+    timerJitter.lastHandleUs = handleUs;
+    if (lateUs > timerJitter.maxUs)
+      timerJitter.maxUs = lateUs;
+    if (handleUs > timerJitter.maxHandleUs)
+      timerJitter.maxHandleUs = handleUs;
+  }
+
+  int64_t now = esp_timer_get_time();
+  bool expired = false;
+  while (timerHeapSize > 0 && timers[timerHeap[0]].deadlineUs <= now)
+  {
+    int index = timerHeap[0];
+    CountdownTimer &t = timers[index];
+    expired = true;
+
+    // Program: next phase's deadline is already known, re-key it in place and chime
+    if (t.phaseCount > 0 && advanceTimerPhase(t))
+    {
+      timerHeapSiftDown(0);
+      if (t.phases[t.phase].tone > 0)
+        playMelody(MELODY_CHIME, t.phases[t.phase].tone, TONE_CHIME, PROFILE_CHIME);
+      continue;
+    }
+
+    timerHeapRemoveAt(0);
+    t.active = false;
+    timersDirty = true;
+
+    // Timer finished - trigger 5-second alarm
+    timerAlert.triggered = true;
+    timerAlert.startTime = millis();
+    strncpy(timerAlert.label, timers[index].label, sizeof(timerAlert.label) - 1);
+    Serial.println("=== COUNTDOWN FINISHED - 5 SECOND ALARM: " + String(timers[index].label) + " ===");
+  }
+
+  if (expired)
+    armTimerClock();
+}
+
+void updateAlarmDisplay()
+{
+  static unsigned long lastBlink = 0;
+  static bool blinkState = false;
+
+  if (millis() - lastBlink > 500)
+  {
+    lastBlink = millis();
+    blinkState = !blinkState;
+
+    if (blinkState)
     {
-      unsigned long pressDuration = millis() - pressStartTime;
+      String label = "WAKE UP!";
+      if (activeAlarmIndex >= 0)
+      {
+        label = alarms[activeAlarmIndex].label;
+      }
+
+      displayOverlay(LAYER_ALARM, "*** ALARM ***", label.c_str(), 500);
+    }
+  }
+
+  // Nobody answered before the profile's ring time: snooze instead of dropping the alarm
+  if (millis() - stateStartTime > alarmRingTimeoutMs(activeAlarmIndex))
+  {
+    Serial.println("Alarm ring timeout");
+    snoozeAlarm();
+  }
+}
+
+// ==========================================
+// INPUT SAMPLING
+// ==========================================
+// One periodic esp_timer reads GPIO_IN_REG and debounces every pin in INPUT_MASK at
+// once with 3-bit vertical counters: a bit flips after 8 consecutive samples at its
+// new level and any disagreeing sample restarts its count. The cost of a tick is the
+// same for one input or thirty-two, and the outcome depends only on the samples.
+
+void postButtonEvent(uint8_t input, uint8_t gesture, uint32_t heldMs, int64_t edgeUs = 0)
+{
+  ButtonEvent event = {input, gesture, heldMs, edgeUs};
+  buttonStats.gestures++;
+  if (xQueueSend(buttonEvents, &event, 0) != pdTRUE)
+    buttonStats.dropped++;
+}
 
-      if (pressDuration >= 5000)
+// Press/release come from the debounced word; changedUs is the first sample at the new level
+void decodeButton(ButtonDecoder &button, uint32_t state, int64_t changedUs, int64_t now)
+{
+  bool down = !(state & (1UL << button.pin));
+  if (down != button.down)
+  {
+    button.down = down;
+    if (down)
+    {
+      button.pressUs = changedUs;
+      postButtonEvent(button.input, BUTTON_DOWN, 0, changedUs);
+    }
+    else
+    {
+      uint32_t heldMs = (changedUs - button.pressUs) / 1000;
+      if (heldMs < BUTTON_LONG_PRESS_MS)
       {
-        factoryReset();
+        if (button.clickPending)
+          postButtonEvent(button.input, BUTTON_DOUBLE_CLICK, heldMs);
+        else
+          button.clickReleaseUs = changedUs;
+        button.clickPending = !button.clickPending;
       }
       else
       {
-        // Ưu tiên xử lý báo thức và timer nếu đang active
-        if (currentState == STATE_ALARM)
-        {
-          stopAlarm();
-        }
-        else if (timer.alarmTriggered)
-        {
-          timer.alarmTriggered = false;
-          timer.finished = false;
-          digitalWrite(BUZZER_PIN, LOW);
-          digitalWrite(LED_PIN, LOW);
-          Serial.println("Timer alarm stopped by button");
-        }
-        // Nếu ở trạng thái bình thường, không có alarm/timer thì mới chuyển LCD
-        else if (currentState == STATE_NORMAL)
-        {
-          switchLcdDisplayMode();
-          Serial.println("LCD display mode switched");
-        }
+        if (button.clickPending)
+          postButtonEvent(button.input, BUTTON_CLICK, 0);
+        button.clickPending = false;
+        postButtonEvent(button.input, heldMs >= BUTTON_FACTORY_RESET_MS ? BUTTON_VERY_LONG_PRESS : BUTTON_LONG_PRESS, heldMs);
+      }
+    }
+  }
+
+  // No second press in time (a press still held is decided on its release)
+  if (button.clickPending && !button.down && now - button.clickReleaseUs >= BUTTON_DOUBLE_CLICK_MS * 1000LL)
+  {
+    button.clickPending = false;
+    postButtonEvent(button.input, BUTTON_CLICK, 0);
+  }
+}
+
+void onInputSample(void *)
+{
+  static uint32_t count0 = 0, count1 = 0, count2 = 0; // bit n of each = counter of pin n
+  int64_t now = esp_timer_get_time();
+  uint32_t state = inputState.load(std::memory_order_relaxed);
+
+  uint32_t delta = (REG_READ(GPIO_IN_REG) ^ state) & INPUT_MASK;
+  uint32_t carry0 = count0 & delta;
+  count0 = (count0 ^ delta) & delta;
+  uint32_t carry1 = count1 & carry0;
+  count1 = (count1 ^ carry0) & delta;
+  uint32_t flips = count2 & carry1; // counter wrapped from 7: 8th sample at the new level
+  count2 = (count2 ^ carry1) & delta;
+
+  inputStats.samples++;
+  if (flips)
+  {
+    state ^= flips;
+    inputState.store(state, std::memory_order_release);
+    inputStats.changes += __builtin_popcount(flips);
+  }
+
+  for (ButtonDecoder &button : buttons)
+    decodeButton(button, state, now - INPUT_DEBOUNCE_US + INPUT_SAMPLE_US, now);
+
+  // The ISR mute lasts for one debounced press. It ends on the release (release bounce
+  // fires the ISR again while the press is still down), or after a quiet spell when the
+  // edge turned out to be noise and no press followed.
+  static uint32_t seenKillEdges = 0;
+  static int64_t killSeenUs = 0;
+  static bool pressSinceKill = false;
+  static bool mainWasDown = false;
+  bool mainDown = buttons[INPUT_MAIN].down;
+  if (buzzerKillEdges != seenKillEdges)
+  {
+    seenKillEdges = buzzerKillEdges;
+    killSeenUs = now;
+    pressSinceKill = false;
+  }
+  pressSinceKill |= mainDown;
+  if (mainWasDown && !mainDown)
+    buzzerKilled = false;
+  else if (buzzerKilled && !pressSinceKill && now - killSeenUs > 2 * INPUT_DEBOUNCE_US)
+    buzzerKilled = false;
+  mainWasDown = mainDown;
+
+  uint32_t took = esp_timer_get_time() - now;
+  if (took > inputStats.maxSampleUs)
+    inputStats.maxSampleUs = took;
+}
+
+void startInputSampler()
+{
+  buttonEvents = xQueueCreate(8, sizeof(ButtonEvent));
+
+  esp_timer_create_args_t args = {};
+  args.callback = onInputSample;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "inputs";
+  if (buttonEvents == nullptr || esp_timer_create(&args, &inputSampler) != ESP_OK ||
+      esp_timer_start_periodic(inputSampler, INPUT_SAMPLE_US) != ESP_OK)
+  {
+    inputSampler = nullptr;
+    Serial.println("✗ Input sampler unavailable, button disabled");
+  }
+}
+
+// ==========================================
+// ON-DEVICE ALARM EDITOR
+// ==========================================
+// Turn the knob to pick an alarm (or "New alarm"), OK to edit. Fields are edited in
+// order hour -> minute -> days -> on/off -> save/delete/cancel: the knob changes the
+// value, OK moves on, BACK goes one field back. Idle for MENU_IDLE_TIMEOUT_MS discards.
+
+#define MENU_IDLE_TIMEOUT_MS 30000
+
+enum MenuField : uint8_t
+{
+  FIELD_HOUR,
+  FIELD_MINUTE,
+  FIELD_DAYS,
+  FIELD_ENABLED,
+  FIELD_CONFIRM
+};
+
+enum MenuConfirm : uint8_t
+{
+  CONFIRM_SAVE,
+  CONFIRM_DELETE,
+  CONFIRM_CANCEL,
+  CONFIRM_COUNT
+};
+
+struct DaysPreset
+{
+  const char *name;
+  uint8_t repeat;
+  uint8_t weekMask; // bit d = day-of-week d (0 = Sunday)
+};
+
+const DaysPreset daysPresets[] = {
+    {"Once", REPEAT_ONCE, 0},
+    {"Daily", REPEAT_WEEKLY, 0x7F},
+    {"Mon-Fri", REPEAT_WEEKLY, 0x3E},
+    {"Weekend", REPEAT_WEEKLY, 0x41},
+};
+#define DAYS_PRESET_COUNT (int)(sizeof(daysPresets) / sizeof(daysPresets[0]))
+
+struct MenuState
+{
+  bool open = false;
+  bool editing = false; // false = picking a slot
+  int slot = 0;         // alarms[] index, alarmCount = new alarm
+  uint8_t field = FIELD_HOUR;
+  int preset = 0; // daysPresets index, -1 = keep the alarm's own rule
+  uint8_t confirm = CONFIRM_SAVE;
+  Alarm draft;
+  unsigned long lastInput = 0;
+} menu;
+
+int wrapValue(int value, int count)
+{
+  return (value % count + count) % count;
+}
+
+uint8_t alarmWeekMask(const Alarm &alarm)
+{
+  uint8_t mask = 0;
+  for (int i = 0; i < 7; i++)
+    if (alarm.daysOfWeek[i])
+      mask |= 1 << i;
+  return mask;
+}
+
+int findDaysPreset(const Alarm &alarm)
+{
+  for (int i = 0; i < DAYS_PRESET_COUNT; i++)
+    if (alarm.repeat == daysPresets[i].repeat &&
+        (alarm.repeat != REPEAT_WEEKLY || alarmWeekMask(alarm) == daysPresets[i].weekMask))
+      return i;
+  return -1;
+}
+
+// Short schedule text for 16 columns: preset name, "-MTWTF-" for other weekday sets, or the rule kind
+String alarmDaysText(const Alarm &alarm, int preset)
+{
+  if (preset >= 0)
+    return daysPresets[preset].name;
+  if (alarm.repeat == REPEAT_WEEKLY)
+  {
+    char text[] = "SMTWTFS";
+    for (int i = 0; i < 7; i++)
+      if (!alarm.daysOfWeek[i])
+        text[i] = '-';
+    return String(text);
+  }
+  if (alarm.repeat == REPEAT_EVERY_N_DAYS)
+    return "Every " + String(alarm.interval) + "d";
+  return "Nth day";
+}
+
+int menuSlotCount()
+{
+  return alarmCount < MAX_ALARMS ? alarmCount + 1 : alarmCount;
+}
+
+void renderMenu()
+{
+  char line1[LCD_TEXT_MAX + 1];
+  char line2[LCD_TEXT_MAX + 1];
+
+  if (!menu.editing)
+  {
+    if (menu.slot < alarmCount)
+    {
+      const Alarm &alarm = alarms[menu.slot];
+      snprintf(line1, sizeof(line1), "Alarm %d/%d %02d:%02d", menu.slot + 1, alarmCount, alarm.hour, alarm.minute);
+      snprintf(line2, sizeof(line2), "%s %s", alarmDaysText(alarm, findDaysPreset(alarm)).c_str(), alarm.enabled ? "ON" : "OFF");
+    }
+    else
+    {
+      strcpy(line1, "New alarm");
+      strcpy(line2, alarmCount == 0 ? "No alarms yet" : "OK to add");
+    }
+    displayOverlay(LAYER_MENU, line1, line2, 0);
+    return;
+  }
+
+  const Alarm &draft = menu.draft;
+  String days = alarmDaysText(draft, menu.preset);
+  snprintf(line1, sizeof(line1), "%02d:%02d %s", draft.hour, draft.minute, days.c_str());
+
+  static const char *confirmNames[CONFIRM_COUNT] = {"Save", "Delete", "Cancel"};
+  switch (menu.field)
+  {
+  case FIELD_HOUR:
+    snprintf(line2, sizeof(line2), "Hour <%02d>", draft.hour);
+    break;
+  case FIELD_MINUTE:
+    snprintf(line2, sizeof(line2), "Minute <%02d>", draft.minute);
+    break;
+  case FIELD_DAYS:
+    snprintf(line2, sizeof(line2), "Days <%s>", days.c_str());
+    break;
+  case FIELD_ENABLED:
+    snprintf(line2, sizeof(line2), "Alarm <%s>", draft.enabled ? "ON" : "OFF");
+    break;
+  default:
+    snprintf(line2, sizeof(line2), "<%s>", confirmNames[menu.confirm]);
+    break;
+  }
+  displayOverlay(LAYER_MENU, line1, line2, 0);
+}
+
+void openMenu()
+{
+  menu.open = true;
+  menu.editing = false;
+  menu.slot = 0;
+  menu.lastInput = millis();
+  renderMenu();
+  Serial.println("Menu opened");
+}
+
+void closeMenu()
+{
+  menu.open = false;
+  displayClearOverlay(LAYER_MENU);
+}
+
+void startEditing()
+{
+  if (menu.slot < alarmCount)
+  {
+    menu.draft = alarms[menu.slot];
+  }
+  else
+  {
+    DateTime now = readRtc();
+    menu.draft = Alarm();
+    menu.draft.hour = now.hour();
+    menu.draft.minute = 0;
+    menu.draft.enabled = true;
+    menu.draft.repeat = REPEAT_ONCE;
+  }
+  menu.preset = findDaysPreset(menu.draft);
+  menu.field = FIELD_HOUR;
+  menu.confirm = CONFIRM_SAVE;
+  menu.editing = true;
+}
+
+void saveMenuDraft()
+{
+  Alarm &draft = menu.draft;
+  if (menu.preset >= 0)
+  {
+    const DaysPreset &preset = daysPresets[menu.preset];
+    draft.repeat = preset.repeat;
+    for (int i = 0; i < 7; i++)
+      draft.daysOfWeek[i] = preset.weekMask & (1 << i);
+    if (preset.repeat == REPEAT_ONCE)
+      draft.startDay = nextAlarmDay(draft.hour, draft.minute);
+  }
+
+  // The web page may have deleted alarms meanwhile: an edit of a vanished slot becomes a new one
+  if (menu.slot < alarmCount)
+  {
+    alarms[menu.slot] = draft;
+  }
+  else if (alarmCount < MAX_ALARMS)
+  {
+    alarms[alarmCount++] = draft;
+  }
+  else
+  {
+    displayNotice("Alarms full", NULL, 2000);
+    return;
+  }
+  saveAlarms();
+  scheduleAlarms(readRtc().unixtime());
+  displayNotice("Alarm saved", NULL, 2000);
+  Serial.printf("Alarm %02d:%02d saved from the menu\n", draft.hour, draft.minute);
+}
+
+void menuStep(int direction)
+{
+  if (!menu.editing)
+  {
+    menu.slot = wrapValue(menu.slot + direction, menuSlotCount());
+    return;
+  }
+
+  Alarm &draft = menu.draft;
+  switch (menu.field)
+  {
+  case FIELD_HOUR:
+    draft.hour = wrapValue(draft.hour + direction, 24);
+    break;
+  case FIELD_MINUTE:
+    draft.minute = wrapValue(draft.minute + direction, 60);
+    break;
+  case FIELD_DAYS:
+    menu.preset = menu.preset < 0 ? 0 : wrapValue(menu.preset + direction, DAYS_PRESET_COUNT);
+    break;
+  case FIELD_ENABLED:
+    draft.enabled = !draft.enabled;
+    break;
+  default:
+    menu.confirm = wrapValue(menu.confirm + direction, CONFIRM_COUNT);
+    if (menu.confirm == CONFIRM_DELETE && menu.slot >= alarmCount)
+      menu.confirm = wrapValue(menu.confirm + direction, CONFIRM_COUNT); // nothing to delete yet
+    break;
+  }
+}
+
+void menuSelect()
+{
+  if (!menu.editing)
+  {
+    startEditing();
+    return;
+  }
+  if (menu.field < FIELD_CONFIRM)
+  {
+    menu.field++;
+    return;
+  }
+
+  if (menu.confirm == CONFIRM_SAVE)
+    saveMenuDraft();
+  else if (menu.confirm == CONFIRM_DELETE && menu.slot < alarmCount)
+  {
+    deleteAlarm(menu.slot);
+    displayNotice("Alarm deleted", NULL, 2000);
+  }
+  menu.editing = false;
+  menu.slot = constrain(menu.slot, 0, menuSlotCount() - 1);
+}
+
+void menuBack()
+{
+  if (!menu.editing)
+    closeMenu();
+  else if (menu.field > FIELD_HOUR)
+    menu.field--;
+  else
+    menu.editing = false;
+}
+
+// ==========================================
+// BUTTON HANDLING
+// ==========================================
+// Gestures and knob detents go through keymap[]: the first row matching the current
+// context, input and gesture decides the action.
+
+enum KeyContext : uint8_t
+{
+  KEYS_ALARM, // alarm ringing
+  KEYS_MENU,  // alarm editor open
+  KEYS_IDLE,  // clock / countdown
+  KEYS_ANY    // everywhere except a ringing alarm
+};
+
+enum KeyAction : uint8_t
+{
+  ACTION_SNOOZE,
+  ACTION_DISMISS,
+  ACTION_FACTORY_RESET,
+  ACTION_PAGE_NEXT,
+  ACTION_PAGE_PREV,
+  ACTION_MENU_OPEN,
+  ACTION_MENU_NEXT,
+  ACTION_MENU_PREV,
+  ACTION_MENU_SELECT,
+  ACTION_MENU_BACK,
+  ACTION_MENU_EXIT
+};
+
+struct KeyBinding
+{
+  uint8_t context;
+  uint8_t input;
+  uint8_t gesture;
+  uint8_t action;
+};
+
+const KeyBinding keymap[] = {
+    // Ưu tiên xử lý báo thức: nhấn ngắn = báo lại, nhấn giữ = tắt hẳn
+    {KEYS_ALARM, INPUT_MAIN, BUTTON_CLICK, ACTION_SNOOZE},
+    {KEYS_ALARM, INPUT_MAIN, BUTTON_DOUBLE_CLICK, ACTION_SNOOZE},
+    {KEYS_ALARM, INPUT_MAIN, BUTTON_LONG_PRESS, ACTION_DISMISS},
+    {KEYS_ALARM, INPUT_MAIN, BUTTON_VERY_LONG_PRESS, ACTION_DISMISS},
+    {KEYS_ALARM, INPUT_SELECT, BUTTON_CLICK, ACTION_SNOOZE},
+    {KEYS_ALARM, INPUT_SELECT, BUTTON_DOUBLE_CLICK, ACTION_SNOOZE},
+    {KEYS_ALARM, INPUT_SELECT, BUTTON_LONG_PRESS, ACTION_DISMISS},
+    {KEYS_ALARM, INPUT_SELECT, BUTTON_VERY_LONG_PRESS, ACTION_DISMISS},
+    {KEYS_ALARM, INPUT_BACK, BUTTON_CLICK, ACTION_SNOOZE},
+    {KEYS_ALARM, INPUT_BACK, BUTTON_DOUBLE_CLICK, ACTION_SNOOZE},
+    {KEYS_ALARM, INPUT_BACK, BUTTON_LONG_PRESS, ACTION_DISMISS},
+    {KEYS_ALARM, INPUT_BACK, BUTTON_VERY_LONG_PRESS, ACTION_DISMISS},
+
+    {KEYS_ANY, INPUT_MAIN, BUTTON_VERY_LONG_PRESS, ACTION_FACTORY_RESET},
+
+    {KEYS_MENU, INPUT_ENCODER, ENCODER_CW, ACTION_MENU_NEXT},
+    {KEYS_MENU, INPUT_ENCODER, ENCODER_CCW, ACTION_MENU_PREV},
+    {KEYS_MENU, INPUT_SELECT, BUTTON_CLICK, ACTION_MENU_SELECT},
+    {KEYS_MENU, INPUT_SELECT, BUTTON_LONG_PRESS, ACTION_MENU_EXIT},
+    {KEYS_MENU, INPUT_BACK, BUTTON_CLICK, ACTION_MENU_BACK},
+    {KEYS_MENU, INPUT_BACK, BUTTON_LONG_PRESS, ACTION_MENU_EXIT},
+    {KEYS_MENU, INPUT_MAIN, BUTTON_CLICK, ACTION_MENU_BACK},
+
+    // Nút chính chuyển trang LCD, nhấn đúp quay lại trang trước
+    {KEYS_IDLE, INPUT_MAIN, BUTTON_CLICK, ACTION_PAGE_NEXT},
+    {KEYS_IDLE, INPUT_MAIN, BUTTON_LONG_PRESS, ACTION_PAGE_NEXT},
+    {KEYS_IDLE, INPUT_MAIN, BUTTON_DOUBLE_CLICK, ACTION_PAGE_PREV},
+    {KEYS_IDLE, INPUT_ENCODER, ENCODER_CW, ACTION_PAGE_NEXT},
+    {KEYS_IDLE, INPUT_ENCODER, ENCODER_CCW, ACTION_PAGE_PREV},
+    {KEYS_IDLE, INPUT_SELECT, BUTTON_CLICK, ACTION_MENU_OPEN},
+};
+
+void runKeyAction(uint8_t action)
+{
+  switch (action)
+  {
+  case ACTION_SNOOZE:
+    snoozeAlarm();
+    break;
+  case ACTION_DISMISS:
+    dismissAlarm();
+    break;
+  case ACTION_FACTORY_RESET:
+    factoryReset();
+    break;
+  case ACTION_PAGE_PREV:
+    lcdDisplayMode = wrapValue(lcdDisplayMode - 2, lcdConfig.pageCount); // switchLcdDisplayMode() steps forward one
+    switchLcdDisplayMode();
+    Serial.println("LCD display mode switched");
+    break;
+  case ACTION_PAGE_NEXT:
+    switchLcdDisplayMode();
+    Serial.println("LCD display mode switched");
+    break;
+  case ACTION_MENU_OPEN:
+    openMenu();
+    break;
+  case ACTION_MENU_EXIT:
+    closeMenu();
+    break;
+  default:
+    if (action == ACTION_MENU_NEXT || action == ACTION_MENU_PREV)
+      menuStep(action == ACTION_MENU_NEXT ? 1 : -1);
+    else if (action == ACTION_MENU_SELECT)
+      menuSelect();
+    else
+      menuBack();
+    if (menu.open)
+      renderMenu();
+    break;
+  }
+}
+
+void dispatchInput(uint8_t input, uint8_t gesture)
+{
+  uint8_t context = currentState == STATE_ALARM ? KEYS_ALARM : menu.open ? KEYS_MENU : KEYS_IDLE;
+  if (menu.open)
+    menu.lastInput = millis();
+
+  for (const KeyBinding &key : keymap)
+  {
+    if (key.input != input || key.gesture != gesture)
+      continue;
+    if (key.context == context || (key.context == KEYS_ANY && context != KEYS_ALARM))
+    {
+      runKeyAction(key.action);
+      return;
+    }
+  }
+
+  // Its press already silenced the melody: a gesture with no row must not leave the
+  // alarm muted until the ring timeout
+  if (context == KEYS_ALARM && input != INPUT_ENCODER)
+    runKeyAction(ACTION_SNOOZE);
+}
+
+// Act on the decoded gestures and knob detents
+void handleButton()
+{
+  static bool pressSilenced[BUTTON_COUNT] = {}; // the button's press stopped a buzzer: its release does nothing else
+  ButtonEvent event;
+  while (buttonEvents && xQueueReceive(buttonEvents, &event, 0) == pdTRUE)
+  {
+    if (event.gesture == BUTTON_DOWN)
+    {
+      if (event.input == INPUT_MAIN)
+      {
+        uint32_t latencyUs = esp_timer_get_time() - event.edgeUs;
+        buzzerKillStats.loopLatencyUs = latencyUs;
+        if (latencyUs > buzzerKillStats.loopLatencyMaxUs)
+          buzzerKillStats.loopLatencyMaxUs = latencyUs;
       }
+
+      pressSilenced[event.input] = false;
+      // Keep the alarm quiet; snooze vs dismiss is decided when the button is released
+      if (currentState == STATE_ALARM || alarmActive)
+      {
+        stopMelody(TONE_ALARM);
+        Serial.println("Alarm silenced by button");
+      }
+      if (timerAlert.triggered)
+      {
+        timerAlert.triggered = false;
+        pressSilenced[event.input] = true;
+        stopMelody(TONE_TIMER);
+        Serial.println("Timer alarm stopped by button");
+      }
+      buzzerKilled = false; // the stopped melodies keep it quiet from here
+      continue;
+    }
+
+    if (pressSilenced[event.input] && currentState != STATE_ALARM && event.gesture != BUTTON_VERY_LONG_PRESS)
+    {
+      pressSilenced[event.input] = false;
+      continue;
     }
+    dispatchInput(event.input, event.gesture);
+  }
+
+  // Whole detents only; a half-turned knob keeps its remainder
+  static int32_t consumedSteps = 0;
+  int32_t steps = encoderSteps.load(std::memory_order_relaxed);
+  while (steps - consumedSteps >= ENCODER_STEPS_PER_DETENT)
+  {
+    consumedSteps += ENCODER_STEPS_PER_DETENT;
+    dispatchInput(INPUT_ENCODER, ENCODER_CW);
+  }
+  while (steps - consumedSteps <= -ENCODER_STEPS_PER_DETENT)
+  {
+    consumedSteps -= ENCODER_STEPS_PER_DETENT;
+    dispatchInput(INPUT_ENCODER, ENCODER_CCW);
   }
 
-  lastState = buttonState;
+  if (menu.open && millis() - menu.lastInput > MENU_IDLE_TIMEOUT_MS)
+  {
+    closeMenu();
+    Serial.println("Menu closed (idle)");
+  }
 }
 
 // ==========================================
-// INTERRUPT HANDLER FOR IMMEDIATE BUZZER CONTROL
+// INTERRUPT HANDLER
 // ==========================================
 
-// Interrupt Service Routine for button press
+// Falling edge: silence the buzzer now, the sampler decides later what the press was.
+// Only register accesses and IRAM functions: nothing here can block or miss cache.
+// Set by measureBuzzerKill() around the edge it makes; cycle counts are per core, so the
+// ISR records where it ran
+volatile bool killProbeArmed = false;
+volatile uint32_t killProbeEdgeCycles = 0;
+volatile uint32_t killProbeParkCycles = 0;
+volatile int killProbeCore = -1;
+
 void IRAM_ATTR buttonInterrupt()
 {
-  unsigned long currentTime = millis();
-
-  // Simple debouncing - ignore interrupts within 50ms of the last one
-  if (currentTime - lastInterruptTime > 50)
+  int64_t entryUs = esp_timer_get_time();
+  if (!(REG_READ(GPIO_IN_REG) & (1UL << BUTTON_PIN)))
   {
-    lastInterruptTime = currentTime;
-
-    // Check if button is actually pressed (LOW due to INPUT_PULLUP)
-    if (digitalRead(BUTTON_PIN) == LOW)
+    buzzerKilled = true;
+    buzzerKillEdges = buzzerKillEdges + 1;
+    if (toneSounding)
     {
-      // Immediately turn off buzzer if it's currently sounding
-      if (digitalRead(BUZZER_PIN) == HIGH)
+      // LEDC owns both pins: park the channels at their idle level (low). The next
+      // note the sequencer plays re-enables the outputs.
+      LEDC.channel_group[0].channel[BUZZER_LEDC_CHANNEL].conf0.idle_lv = 0;
+      LEDC.channel_group[0].channel[BUZZER_LEDC_CHANNEL].conf0.sig_out_en = 0;
+      LEDC.channel_group[0].channel[LED_LEDC_CHANNEL].conf0.idle_lv = 0;
+      LEDC.channel_group[0].channel[LED_LEDC_CHANNEL].conf0.sig_out_en = 0;
+      if (killProbeArmed)
       {
-        digitalWrite(BUZZER_PIN, LOW);
-        digitalWrite(LED_PIN, LOW);
-        buzzerStopRequested = true;
-        Serial.println("Buzzer stopped by interrupt!");
+        killProbeParkCycles = cpu_hal_get_cycle_count();
+        killProbeCore = xPortGetCoreID();
+        killProbeArmed = false;
       }
+      toneSounding = false;
+      uint32_t us = esp_timer_get_time() - entryUs;
+      buzzerKillStats.kills = buzzerKillStats.kills + 1;
+      buzzerKillStats.isrLastUs = us;
+      if (us > buzzerKillStats.isrMaxUs)
+        buzzerKillStats.isrMaxUs = us;
     }
   }
 }
 
+// Edge-to-silence probe: with a faint test tone on, BUTTON_PIN is pulled low through its
+// own open-drain output and the cycle counter is read right before that write. The ISR
+// reads it again once LEDC is parked, so the interval covers the GPIO edge, the
+// interrupt dispatch and the ISR. The pulse is far shorter than INPUT_DEBOUNCE_US, so
+// the sampler never decodes it as a press. Returns ns, or -1 when the buzzer is busy
+// or the ISR did not run on this core.
+int32_t measureBuzzerKill()
+{
+  if (toneSounding || currentState == STATE_ALARM || alarmActive || timerAlert.triggered)
+    return -1;
+
+  ledcSetup(BUZZER_LEDC_CHANNEL, 2000, BUZZER_LEDC_RESOLUTION);
+  ledcWrite(BUZZER_LEDC_CHANNEL, 1); // a click at the lowest duty
+  toneSounding = true;
+
+  killProbeCore = -1;
+  REG_WRITE(GPIO_OUT_W1TS_REG, 1UL << BUTTON_PIN); // released level first: no edge yet
+  gpio_set_direction((gpio_num_t)BUTTON_PIN, GPIO_MODE_INPUT_OUTPUT_OD);
+  killProbeArmed = true;
+  killProbeEdgeCycles = cpu_hal_get_cycle_count();
+  REG_WRITE(GPIO_OUT_W1TC_REG, 1UL << BUTTON_PIN);
+
+  int64_t deadline = esp_timer_get_time() + 1000;
+  while (killProbeArmed && esp_timer_get_time() < deadline)
+  {
+  }
+  REG_WRITE(GPIO_OUT_W1TS_REG, 1UL << BUTTON_PIN);
+  gpio_set_direction((gpio_num_t)BUTTON_PIN, GPIO_MODE_INPUT); // the pull-up stays configured
+
+  bool parked = !killProbeArmed && killProbeCore == xPortGetCoreID();
+  killProbeArmed = false;
+  ledcWrite(BUZZER_LEDC_CHANNEL, 0);
+  ledcWrite(LED_LEDC_CHANNEL, sunriseLevel);
+  toneSounding = false;
+  buzzerKilled = false; // nothing was pressed
+  if (!parked)
+    return -1;
+
+  uint32_t ns = (uint64_t)(killProbeParkCycles - killProbeEdgeCycles) * 1000 / getCpuFrequencyMhz();
+  buzzerKillStats.probes++;
+  buzzerKillStats.edgeToSilenceNs = ns;
+  if (ns > buzzerKillStats.edgeToSilenceMaxNs)
+    buzzerKillStats.edgeToSilenceMaxNs = ns;
+  return ns;
+}
+
+// Index = previous A/B << 2 | current A/B. Valid Gray-code moves count one quarter step;
+// contact bounce on one channel steps back and forth and cancels out; a skipped state
+// (both channels changed) is ambiguous and counts nothing. In DRAM so the ISR never
+// touches flash. Swap ENCODER_A_PIN/ENCODER_B_PIN if the knob turns the wrong way.
+DRAM_ATTR const int8_t encoderTransitions[16] = {0, -1, 1, 0, 1, 0, 0, -1, -1, 0, 0, 1, 0, 1, -1, 0};
+
+void IRAM_ATTR encoderInterrupt()
+{
+  uint32_t in = REG_READ(GPIO_IN_REG);
+  uint8_t phase = ((in >> ENCODER_A_PIN) & 1) << 1 | ((in >> ENCODER_B_PIN) & 1);
+  int8_t step = encoderTransitions[encoderPhase << 2 | phase];
+  encoderPhase = phase;
+  if (step)
+    encoderSteps.store(encoderSteps.load(std::memory_order_relaxed) + step, std::memory_order_relaxed);
+}
+
 // ==========================================
 // WEB INTERFACE
 // ==========================================
 
 String generateWebInterface()
 {
-  DateTime now = rtc.now();
+  DateTime now = readRtc();
 
   String html = "<!DOCTYPE html><html><head>";
   html += "<meta charset='UTF-8'>";
@@ -754,12 +3137,41 @@ String generateWebInterface()
 
   // LCD Display
   html += "<div class='card'>";
-  html += "<h3>📺 Màn hình LCD (Chế độ " + String(lcdDisplayMode == 0 ? "Đồng hồ" : "Thời tiết") + ")</h3>";
+  html += "<h3>📺 Màn hình LCD (Chế độ " + String(currentLcdPage().title) + ")</h3>";
   html += "<div class='lcd'>";
   html += "Dòng 1: " + currentLCDLine1 + "<br>";
   html += "Dòng 2: " + currentLCDLine2;
   html += "</div>";
-  html += "<small style='opacity: 0.8;'>Tự động chuyển đổi mỗi 60 giây</small>";
+  if (lcdConfig.dwellSeconds > 0)
+    html += "<small style='opacity: 0.8;'>Tự động chuyển đổi mỗi " + String(lcdConfig.dwellSeconds) + " giây</small>";
+  html += "<form action='/lcd-config' method='POST' style='margin-top: 15px;'>";
+  html += "<div class='grid grid-2'>";
+  html += "<div class='form-group'>";
+  html += "<label>📑 Thứ tự trang:</label>";
+  html += "<input type='text' name='pages' value='" + lcdPageOrderString() + "'>";
+  html += "<small style='opacity: 0.8;'>";
+  for (int i = 0; i < LCD_PAGE_COUNT; i++)
+    html += String(i > 0 ? ", " : "") + lcdPages[i].id + " (" + lcdPages[i].title + ")";
+  html += "</small>";
+  html += "</div>";
+  html += "<div class='form-group'>";
+  html += "<label>⏳ Thời gian mỗi trang (giây, 0 = không tự chuyển):</label>";
+  html += "<input type='number' name='dwell' min='0' max='3600' value='" + String(lcdConfig.dwellSeconds) + "'>";
+  html += "</div>";
+  html += "</div>";
+  html += "<div class='form-group'>";
+  html += "<label>↔️ Tốc độ chạy chữ (ms/ký tự):</label>";
+  html += "<input type='number' name='scroll_ms' min='100' max='2000' step='50' value='" + String(lcdConfig.scrollMs) + "'>";
+  html += "</div>";
+  html += "<div class='form-group'>";
+  html += "<label>🔤 Hiển thị ă â đ ê ô ơ ư:</label>";
+  html += "<select name='vn_glyphs'>";
+  html += "<option value='0'" + String(lcdConfig.vietnameseGlyphs ? "" : " selected") + ">Chữ không dấu (a d e o u)</option>";
+  html += "<option value='1'" + String(lcdConfig.vietnameseGlyphs ? " selected" : "") + ">Ký tự tự tạo</option>";
+  html += "</select>";
+  html += "</div>";
+  html += "<button type='submit' class='btn'>💾 Lưu</button>";
+  html += "</form>";
   html += "</div>";
 
   html += "<div class='grid'>";
@@ -858,6 +3270,56 @@ String generateWebInterface()
   html += "<input type='text' name='label' placeholder='VD: Thức dậy đi làm' maxlength='30'>";
   html += "</div>";
   html += "<div class='form-group'>";
+  html += "<label>🎵 Nhạc chuông:</label>";
+  html += "<select name='melody'>";
+  for (int i = 0; i < ALARM_MELODY_COUNT; i++)
+    html += "<option value='" + String(i) + "'>" + melodies[i].name + "</option>";
+  html += "</select>";
+  html += "</div>";
+  html += "<div class='form-group'>";
+  html += "<label>📈 Cường độ (âm lượng, nhịp, đèn LED):</label>";
+  html += "<select name='profile'>";
+  for (int i = 0; i < ALARM_PROFILE_COUNT; i++)
+  {
+    const IntensityProfile &profile = intensityProfiles[i];
+    html += "<option value='" + String(i) + "'>" + profile.name;
+    if (profile.rampSec > 0)
+      html += " (tăng dần " + String(profile.rampSec / 60) + "m" + String(profile.rampSec % 60) + "s)";
+    html += "</option>";
+  }
+  html += "</select>";
+  html += "</div>";
+  html += "<div class='grid grid-2'>";
+  html += "<div class='form-group'>";
+  html += "<label>🔁 Lặp lại:</label>";
+  html += "<select name='repeat'>";
+  html += "<option value='weekly'>Theo ngày trong tuần</option>";
+  html += "<option value='once'>Một lần (theo ngày)</option>";
+  html += "<option value='every'>Mỗi N ngày</option>";
+  html += "<option value='nth'>Thứ X lần N trong tháng</option>";
+  html += "</select>";
+  html += "</div>";
+  html += "<div class='form-group'>";
+  html += "<label>📆 Ngày (một lần / bắt đầu):</label>";
+  html += "<input type='date' name='date'>";
+  html += "</div>";
+  html += "<div class='form-group'>";
+  html += "<label>↔️ Mỗi N ngày:</label>";
+  html += "<input type='number' name='interval' min='1' max='365' placeholder='VD: 2'>";
+  html += "</div>";
+  html += "<div class='form-group'>";
+  html += "<label>🗓️ Lần trong tháng / Thứ:</label>";
+  html += "<div style='display: flex; gap: 8px;'>";
+  html += "<select name='nth'><option value='1'>Đầu tiên</option><option value='2'>Thứ hai</option><option value='3'>Thứ ba</option><option value='4'>Thứ tư</option><option value='5'>Cuối cùng</option></select>";
+  html += "<select name='weekday'><option value='0'>Chủ nhật</option><option value='1'>Thứ 2</option><option value='2'>Thứ 3</option><option value='3'>Thứ 4</option><option value='4'>Thứ 5</option><option value='5'>Thứ 6</option><option value='6'>Thứ 7</option></select>";
+  html += "</div>";
+  html += "</div>";
+  html += "</div>";
+  html += "<div class='form-group' style='display: flex; align-items: center; gap: 10px;'>";
+  html += "<input type='checkbox' name='skip_holidays' id='skip_holidays' style='transform: scale(1.2);'>";
+  html += "<label for='skip_holidays'>🎌 Bỏ qua ngày nghỉ lễ</label>";
+  html += "</div>";
+  html += "<div class='form-group'>";
   html += "<label>📅 Chọn ngày trong tuần:</label>";
   html += "<div class='checkbox-grid'>";
   String days[] = {"Chủ nhật", "Thứ 2", "Thứ 3", "Thứ 4", "Thứ 5", "Thứ 6", "Thứ 7"};
@@ -884,21 +3346,44 @@ String generateWebInterface()
       html += "<div class='alarm-time'>🕐 " + String(alarms[i].hour) + ":" + (alarms[i].minute < 10 ? "0" : "") + String(alarms[i].minute) + "</div>";
       html += "<div class='alarm-label'>📝 " + String(alarms[i].label) + "</div>";
 
-      // Show active days
+      // Show recurrence
       String activeDays = "📅 ";
-      bool hasActiveDays = false;
-      for (int j = 0; j < 7; j++)
+      const Alarm &alarm = alarms[i];
+      if (alarm.repeat == REPEAT_ONCE)
+      {
+        activeDays += "Một lần: " + formatDayNumber(alarm.startDay);
+      }
+      else if (alarm.repeat == REPEAT_EVERY_N_DAYS)
+      {
+        activeDays += "Mỗi " + String(alarm.interval) + " ngày từ " + formatDayNumber(alarm.startDay);
+      }
+      else if (alarm.repeat == REPEAT_NTH_WEEKDAY)
+      {
+        const char *nthNames[] = {"đầu tiên", "thứ hai", "thứ ba", "thứ tư", "cuối cùng"};
+        activeDays += days[alarm.weekday % 7] + " " + nthNames[constrain(alarm.nth, 1, 5) - 1] + " hàng tháng";
+      }
+      else
       {
-        if (alarms[i].daysOfWeek[j])
+        bool hasActiveDays = false;
+        for (int j = 0; j < 7; j++)
         {
-          if (hasActiveDays)
-            activeDays += ", ";
-          activeDays += days[j];
-          hasActiveDays = true;
+          if (alarm.daysOfWeek[j])
+          {
+            if (hasActiveDays)
+              activeDays += ", ";
+            activeDays += days[j];
+            hasActiveDays = true;
+          }
         }
+        if (!hasActiveDays)
+          activeDays += "Không lặp lại";
       }
-      if (!hasActiveDays)
-        activeDays += "Không lặp lại";
+      if (alarm.skipHolidays)
+        activeDays += " · bỏ qua ngày lễ";
+      if (alarm.melody < ALARM_MELODY_COUNT)
+        activeDays += " · 🎵 " + String(melodies[alarm.melody].name);
+      if (alarm.profile < ALARM_PROFILE_COUNT)
+        activeDays += " · 📈 " + String(intensityProfiles[alarm.profile].name);
       html += "<div class='alarm-days'>" + activeDays + "</div>";
       html += "</div>";
       html += "<button onclick=\"deleteAlarm(" + String(i) + ")\" class='btn btn-danger'>🗑️ Xóa</button>";
@@ -909,23 +3394,74 @@ String generateWebInterface()
   {
     html += "<div style='text-align: center; opacity: 0.6; padding: 20px;'>Chưa có báo thức nào</div>";
   }
+
+  // Holidays (exclusion dates)
+  html += "<h4 style='color: #FFD700; margin: 20px 0 15px 0;'>🎌 Ngày nghỉ lễ (" + String(holidayCount) + "/" + String(MAX_HOLIDAYS) + ")</h4>";
+  html += "<form action='/holidays' method='POST'>";
+  html += "<div class='form-group'>";
+  String holidayList = "";
+  for (int i = 0; i < holidayCount; i++)
+  {
+    if (i > 0)
+      holidayList += ", ";
+    holidayList += formatDayNumber(holidays[i], true);
+  }
+  html += "<input type='text' name='dates' value='" + holidayList + "' placeholder='VD: 2026-01-01, 2026-09-02'>";
+  html += "</div>";
+  html += "<button type='submit' class='btn'>💾 Lưu ngày lễ</button>";
+  html += "</form>";
+
+  // Snooze settings
+  html += "<h4 style='color: #FFD700; margin: 20px 0 15px 0;'>😴 Báo lại (nhấn ngắn = báo lại, nhấn giữ = tắt)</h4>";
+  if (snooze.fireTime != 0)
+  {
+    DateTime snoozeAt(snooze.fireTime);
+    html += "<div style='margin-bottom: 10px;'>⏰ Báo lại lúc " + String(snoozeAt.hour()) + ":" + (snoozeAt.minute() < 10 ? "0" : "") + String(snoozeAt.minute()) + " (" + String(snooze.count) + "/" + String(snoozeConfig.maxCount) + ")";
+    html += " <button onclick=\"dismissSnooze()\" class='btn btn-danger'>✖️ Hủy</button></div>";
+  }
+  html += "<form action='/snooze-config' method='POST'>";
+  html += "<div class='grid grid-2'>";
+  html += "<div class='form-group'>";
+  html += "<label>⏱️ Thời gian báo lại (phút):</label>";
+  html += "<input type='number' name='duration' min='1' max='30' value='" + String(snoozeConfig.durationMinutes) + "'>";
+  html += "</div>";
+  html += "<div class='form-group'>";
+  html += "<label>🔁 Số lần báo lại tối đa:</label>";
+  html += "<input type='number' name='max_count' min='0' max='10' value='" + String(snoozeConfig.maxCount) + "'>";
+  html += "</div>";
+  html += "<div class='form-group'>";
+  html += "<label>🌅 Đèn bình minh trước báo thức (phút, 0 = tắt):</label>";
+  html += "<input type='number' name='sunrise' min='0' max='60' value='" + String(sunriseConfig.minutes) + "'>";
+  html += "</div>";
+  html += "</div>";
+  html += "<button type='submit' class='btn'>💾 Lưu</button>";
+  html += "</form>";
   html += "</div>";
 
   // Enhanced Countdown Timer
   html += "<div class='card'>";
   html += "<h3>⏱️ Đồng hồ đếm ngược</h3>";
-  if (timer.active)
+  for (int i = 0; i < MAX_TIMERS; i++)
   {
-    unsigned long remaining = timer.duration - ((millis() - timer.startTime) / 1000);
+    if (!timers[i].active)
+      continue;
+    unsigned long remaining = timerRemaining(i);
     int minutes = remaining / 60;
     int seconds = remaining % 60;
-    html += "<div class='timer-display'>⏱️ " + String(minutes) + ":" + (seconds < 10 ? "0" : "") + String(seconds) + "</div>";
-    html += "<div style='text-align: center; font-size: 1.2rem; margin: 15px 0;'>📝 " + String(timer.label) + "</div>";
-    html += "<div style='text-align: center;'>";
-    html += "<button onclick=\"stopTimer()\" class='btn btn-danger'>⏹️ Dừng đếm ngược</button>";
+    html += "<div class='alarm-item'>";
+    html += "<div>";
+    html += "<div class='timer-display' data-index='" + String(i) + "' style='font-size: 2rem; margin: 0;'>⏱️ " + String(minutes) + ":" + (seconds < 10 ? "0" : "") + String(seconds) + "</div>";
+    html += "<div class='alarm-label'>📝 " + String(timers[i].label) + "</div>";
+    if (timers[i].phaseCount > 0)
+    {
+      const CountdownTimer &t = timers[i];
+      html += "<div class='alarm-days'>🔁 " + String(t.phases[t.phase].label) + " · pha " + String(t.phase + 1) + "/" + String(t.phaseCount) + " · vòng " + String(t.round + 1) + "/" + String(t.rounds) + "</div>";
+    }
+    html += "</div>";
+    html += "<button onclick=\"stopTimer(" + String(i) + ")\" class='btn btn-danger'>⏹️ Dừng</button>";
     html += "</div>";
   }
-  else
+  if (timerHeapSize < MAX_TIMERS)
   {
     html += "<form action='/set-timer' method='POST'>";
     html += "<div class='form-group'>";
@@ -936,7 +3472,27 @@ String generateWebInterface()
     html += "<label>🏷️ Nhãn đếm ngược:</label>";
     html += "<input type='text' name='label' placeholder='VD: Nấu cơm, Họp online' maxlength='30'>";
     html += "</div>";
-    html += "<button type='submit' class='btn btn-success'>▶️ Bắt đầu đếm ngược</button>";
+    html += "<button type='submit' class='btn btn-success'>▶️ Bắt đầu đếm ngược (" + String(timerHeapSize) + "/" + String(MAX_TIMERS) + ")</button>";
+    html += "</form>";
+
+    // Program mode: the whole sequence runs on the device
+    html += "<form action='/set-program' method='POST' style='margin-top: 20px;'>";
+    html += "<div class='form-group'>";
+    html += "<label>🔁 Chương trình (thời lượng:nhãn:số tiếng bíp):</label>";
+    html += "<input type='text' name='phases' list='program-presets' placeholder='VD: 25m:Work:1, 5m:Break:2' required>";
+    html += "<datalist id='program-presets'><option value='25m:Work:1, 5m:Break:2'><option value='40s:Tap:1, 20s:Nghi:2'><option value='10m:Ngam:1, 30s:Lac:3'></datalist>";
+    html += "</div>";
+    html += "<div class='grid grid-2'>";
+    html += "<div class='form-group'>";
+    html += "<label>🔂 Số vòng:</label>";
+    html += "<input type='number' name='repeat' min='1' max='99' value='4'>";
+    html += "</div>";
+    html += "<div class='form-group'>";
+    html += "<label>🏷️ Nhãn:</label>";
+    html += "<input type='text' name='label' placeholder='VD: Pomodoro' maxlength='30'>";
+    html += "</div>";
+    html += "</div>";
+    html += "<button type='submit' class='btn btn-success'>▶️ Chạy chương trình</button>";
     html += "</form>";
   }
   html += "</div>";
@@ -983,7 +3539,8 @@ String generateWebInterface()
   // Enhanced JavaScript with Real-time Updates
   html += "<script>";
   html += "function deleteAlarm(index){if(confirm('🗑️ Bạn có chắc muốn xóa báo thức này?')){fetch('/delete-alarm?index='+index,{method:'POST'}).then(()=>location.reload());}}";
-  html += "function stopTimer(){if(confirm('⏹️ Dừng đếm ngược?')){fetch('/stop-timer',{method:'POST'}).then(()=>updateStatus());}}";
+  html += "function dismissSnooze(){fetch('/dismiss',{method:'POST'}).then(()=>location.reload());}";
+  html += "function stopTimer(index){if(confirm('⏹️ Dừng đếm ngược?')){fetch('/stop-timer?index='+index,{method:'POST'}).then(()=>location.reload());}}";
   html += "function resetWiFi(){if(confirm('🔄 Reset cấu hình WiFi và khởi động lại?')){fetch('/reset-wifi',{method:'POST'});}}";
   html += "function restart(){if(confirm('🔄 Khởi động lại thiết bị?')){fetch('/restart',{method:'POST'});}}";
   html += "function factoryReset(){if(confirm('⚠️ Khôi phục cài đặt gốc? Tất cả dữ liệu sẽ bị xóa!\\n\\nHành động này không thể hoàn tác!')){fetch('/factory-reset',{method:'POST'});}}";
@@ -1035,15 +3592,14 @@ String generateWebInterface()
   html += "});";
 
   // Update timer display
-  html += "const timerCard=document.querySelector('.card h3').parentElement;";
-  html += "if(data.timer.active && data.timer.remaining){";
-  html += "const min=Math.floor(data.timer.remaining/60);";
-  html += "const sec=data.timer.remaining%60;";
-  html += "const timerDisplay=timerCard.querySelector('.timer-display');";
+  html += "(data.timers||[]).forEach(t=>{";
+  html += "const timerDisplay=document.querySelector('.timer-display[data-index=\"'+t.index+'\"]');";
   html += "if(timerDisplay){";
+  html += "const min=Math.floor(t.remaining/60);";
+  html += "const sec=t.remaining%60;";
   html += "timerDisplay.innerHTML='⏱️ '+min+':'+(sec<10?'0':'')+sec;";
   html += "}";
-  html += "}";
+  html += "});";
 
   html += "}).catch(e=>console.log('Status update failed:',e));";
   html += "}";
@@ -1067,6 +3623,32 @@ String generateWebInterface()
 // WEB SERVER ENDPOINTS
 // ==========================================
 
+// Reply to /set-timer and /set-program: JSON for scripts (format=json), redirect for the form
+void sendTimerStarted(int index)
+{
+  if (index < 0)
+  {
+    server.send(409, "text/plain; charset=utf-8", "All " + String(MAX_TIMERS) + " timers are running");
+    return;
+  }
+
+  if (server.arg("format") == "json")
+  {
+    DynamicJsonDocument doc(256);
+    doc["index"] = index;
+    doc["duration"] = timers[index].duration;
+    doc["deadline"] = timers[index].deadlineUnix;
+    doc["phases"] = timers[index].phaseCount;
+    String response;
+    serializeJson(doc, response);
+    server.send(200, "application/json; charset=utf-8", response);
+    return;
+  }
+
+  server.sendHeader("Location", "/");
+  server.send(302);
+}
+
 void setupWebServer()
 {
   Serial.println("===Setting up web server...===");
@@ -1079,17 +3661,43 @@ void setupWebServer()
   server.on("/set-alarm", HTTP_POST, []()
             {
     if(alarmCount < MAX_ALARMS) {
-      alarms[alarmCount].hour = server.arg("hour").toInt();
-      alarms[alarmCount].minute = server.arg("minute").toInt();
-      alarms[alarmCount].enabled = true;
-      strncpy(alarms[alarmCount].label, server.arg("label").c_str(), sizeof(alarms[alarmCount].label) - 1);
-      
+      Alarm &alarm = alarms[alarmCount];
+      alarm = Alarm();
+      alarm.hour = constrain((int)server.arg("hour").toInt(), 0, 23);
+      alarm.minute = constrain((int)server.arg("minute").toInt(), 0, 59);
+      alarm.enabled = true;
+      strncpy(alarm.label, server.arg("label").c_str(), sizeof(alarm.label) - 1);
+      alarm.skipHolidays = server.hasArg("skip_holidays");
+      alarm.melody = constrain((int)server.arg("melody").toInt(), 0, ALARM_MELODY_COUNT - 1);
+      alarm.profile = constrain((int)server.arg("profile").toInt(), 0, ALARM_PROFILE_COUNT - 1);
+
+      uint32_t nextDay = nextAlarmDay(alarm.hour, alarm.minute);
+      uint32_t date = parseDateArg(server.arg("date"));
+
+      String repeat = server.arg("repeat");
+      bool anyDay = false;
       for(int i = 0; i < 7; i++) {
-        alarms[alarmCount].daysOfWeek[i] = server.hasArg("day" + String(i));
+        alarm.daysOfWeek[i] = server.hasArg("day" + String(i));
+        anyDay |= alarm.daysOfWeek[i];
       }
-      
+
+      if (repeat == "every") {
+        alarm.repeat = REPEAT_EVERY_N_DAYS;
+        alarm.interval = constrain((int)server.arg("interval").toInt(), 1, 365);
+        alarm.startDay = date != RULE_NO_DAY ? date : nextDay;
+      } else if (repeat == "nth") {
+        alarm.repeat = REPEAT_NTH_WEEKDAY;
+        alarm.nth = constrain((int)server.arg("nth").toInt(), 1, 5);
+        alarm.weekday = constrain((int)server.arg("weekday").toInt(), 0, 6);
+      } else if (repeat == "once" || !anyDay) {
+        // No weekday picked means "don't repeat": ring once on the given date or the next hh:mm
+        alarm.repeat = REPEAT_ONCE;
+        alarm.startDay = date != RULE_NO_DAY ? date : nextDay;
+      }
+
       alarmCount++;
       saveAlarms();
+      scheduleAlarms(readRtc().unixtime());
     }
     server.sendHeader("Location", "/");
     server.send(302); });
@@ -1097,33 +3705,140 @@ void setupWebServer()
   // Delete alarm
   server.on("/delete-alarm", HTTP_POST, []()
             {
-    int index = server.arg("index").toInt();
-    if(index >= 0 && index < alarmCount) {
-      for(int i = index; i < alarmCount - 1; i++) {
-        alarms[i] = alarms[i + 1];
+    deleteAlarm(server.arg("index").toInt());
+    server.sendHeader("Location", "/");
+    server.send(302); });
+
+  // Holidays: comma/space separated YYYY-MM-DD list, replaces the stored set
+  server.on("/holidays", HTTP_POST, []()
+            {
+    String dates = server.arg("dates");
+    holidayCount = 0;
+    int start = 0;
+    while (start < (int)dates.length() && holidayCount < MAX_HOLIDAYS) {
+      int end = start;
+      while (end < (int)dates.length() && dates[end] != ',' && dates[end] != ' ' && dates[end] != '\n')
+        end++;
+      uint32_t day = parseDateArg(dates.substring(start, end));
+      if (day != RULE_NO_DAY)
+        holidays[holidayCount++] = day;
+      start = end + 1;
+    }
+
+    // Keep sorted and unique for isHoliday()'s binary search
+    for (int i = 1; i < holidayCount; i++) {
+      uint16_t key = holidays[i];
+      int j = i - 1;
+      while (j >= 0 && holidays[j] > key) {
+        holidays[j + 1] = holidays[j];
+        j--;
       }
-      alarmCount--;
-      saveAlarms();
+      holidays[j + 1] = key;
+    }
+    int unique = 0;
+    for (int i = 0; i < holidayCount; i++) {
+      if (unique == 0 || holidays[unique - 1] != holidays[i])
+        holidays[unique++] = holidays[i];
+    }
+    holidayCount = unique;
+
+    saveHolidays();
+    scheduleAlarms(readRtc().unixtime());
+    server.sendHeader("Location", "/");
+    server.send(302); });
+
+  // Snooze / dismiss the ringing alarm
+  server.on("/snooze", HTTP_POST, []()
+            {
+    if (currentState == STATE_ALARM)
+      snoozeAlarm();
+    server.sendHeader("Location", "/");
+    server.send(302); });
+
+  server.on("/dismiss", HTTP_POST, []()
+            {
+    if (currentState == STATE_ALARM)
+      dismissAlarm();
+    else if (snooze.fireTime != 0) {
+      // Cancel a pending snooze from the web UI
+      snooze.fireTime = 0;
+      snooze.alarmIndex = -1;
+      snooze.count = 0;
+      scheduleAlarms(readRtc().unixtime());
     }
     server.sendHeader("Location", "/");
     server.send(302); });
 
-  // Set timer
-  server.on("/set-timer", HTTP_POST, []()
+  // Snooze config
+  server.on("/snooze-config", HTTP_POST, []()
+            {
+    if (server.hasArg("duration"))
+      snoozeConfig.durationMinutes = constrain((int)server.arg("duration").toInt(), 1, 30);
+    if (server.hasArg("max_count"))
+      snoozeConfig.maxCount = constrain((int)server.arg("max_count").toInt(), 0, 10);
+    if (server.hasArg("sunrise"))
+      sunriseConfig.minutes = constrain((int)server.arg("sunrise").toInt(), 0, 60);
+    saveSnoozeConfig();
+    armSunrise();
+    server.sendHeader("Location", "/");
+    server.send(302); });
+
+  // LCD settings: any of scroll_ms, dwell, pages, vn_glyphs=0|1; missing ones are unchanged
+  server.on("/lcd-config", HTTP_POST, []()
             {
-    timer.duration = server.arg("minutes").toInt() * 60;
-    timer.startTime = millis();
-    timer.active = true;
-    strncpy(timer.label, server.arg("label").c_str(), sizeof(timer.label) - 1);
-    currentState = STATE_COUNTDOWN;
+    // Everything is checked on a copy, so a rejected form changes nothing
+    LcdConfig next = lcdConfig;
+    if (server.hasArg("scroll_ms"))
+      next.scrollMs = constrain((int)server.arg("scroll_ms").toInt(), 100, 2000);
+    if (server.hasArg("dwell"))
+      next.dwellSeconds = constrain((int)server.arg("dwell").toInt(), 0, 3600);
+    if (server.hasArg("pages") && !parseLcdPageOrder(server.arg("pages"), next)) {
+      server.send(400, "text/plain; charset=utf-8", "No known page in the list");
+      return;
+    }
+    if (server.hasArg("vn_glyphs"))
+      next.vietnameseGlyphs = server.arg("vn_glyphs") == "1";
+
+    lcdConfig = next;
+    if (server.hasArg("pages")) {
+      lcdDisplayMode = 0; // restart the rotation at its new first page
+      pageForceRedraw = true;
+    }
+    saveLcdConfig();
     server.sendHeader("Location", "/");
     server.send(302); });
 
-  // Stop timer
+  // Set timer: takes a free slot of the pool
+  server.on("/set-timer", HTTP_POST, []()
+            {
+    unsigned long minutes = constrain(server.arg("minutes").toInt(), 1L, 999L);
+    sendTimerStarted(startTimer(minutes * 60, server.arg("label").c_str()));
+  });
+
+  // Set program: phases run back to back on the device, e.g. phases=25m:Work:1,5m:Break:2&repeat=4
+  server.on("/set-program", HTTP_POST, []()
+            {
+    TimerPhase phases[MAX_TIMER_PHASES];
+    int phaseCount = parseTimerPhases(server.arg("phases"), phases);
+    if (phaseCount == 0) {
+      server.send(400, "text/plain; charset=utf-8", "Invalid phases, expected e.g. 25m:Work:1,5m:Break:2");
+      return;
+    }
+    int rounds = server.hasArg("repeat") ? server.arg("repeat").toInt() : 1;
+    sendTimerStarted(startProgram(phases, phaseCount, rounds, server.arg("label").c_str()));
+  });
+
+  // Stop timer: ?index=i, or every timer when no index is given
   server.on("/stop-timer", HTTP_POST, []()
             {
-    timer.active = false;
-    currentState = STATE_NORMAL;
+    if (server.hasArg("index")) {
+      stopTimer(server.arg("index").toInt());
+    } else {
+      for (int i = 0; i < MAX_TIMERS; i++)
+        stopTimer(i);
+    }
+    if (timerHeapSize == 0 && currentState == STATE_COUNTDOWN)
+      currentState = STATE_NORMAL;
     server.sendHeader("Location", "/");
     server.send(302); });
 
@@ -1141,6 +3856,7 @@ void setupWebServer()
   server.on("/reset-wifi", HTTP_POST, []()
             {
     wifiManager.resetSettings();
+    flushTimers(true);
     server.send(200, "text/plain", "WiFi reset. Device restarting...");
     delay(1000);
     ESP.restart(); });
@@ -1148,6 +3864,7 @@ void setupWebServer()
   // Restart
   server.on("/restart", HTTP_POST, []()
             {
+    flushTimers(true);
     server.send(200, "text/plain", "Device restarting...");
     delay(1000);
     ESP.restart(); });
@@ -1178,10 +3895,30 @@ void setupWebServer()
     server.send(302); });
 
   // Status API for real-time updates
+  // Time the button-to-silence path once: JSON with the edge-to-silence interval
+  server.on("/buzzer-kill-test", HTTP_POST, []()
+            {
+    int32_t ns = measureBuzzerKill();
+    if (ns < 0) {
+      server.send(409, "text/plain; charset=utf-8", "Buzzer busy or probe failed");
+      return;
+    }
+    DynamicJsonDocument doc(128);
+    doc["edgeToSilenceNs"] = ns;
+    doc["isrUs"] = buzzerKillStats.isrLastUs;
+    String response;
+    serializeJson(doc, response);
+    server.send(200, "application/json; charset=utf-8", response); });
+
   server.on("/status", HTTP_GET, []()
             {
     DynamicJsonDocument doc(1024);
     doc["temperature"] = currentTemp;
+    doc["ntc"]["mv"] = ntcMillivolts.load();
+    doc["ntc"]["median"] = ntcStats.lastMedian;
+    doc["ntc"]["bursts"] = ntcStats.bursts;
+    doc["ntc"]["overruns"] = ntcStats.overruns;
+    doc["ntc"]["maxBurstUs"] = ntcStats.maxBurstUs;
     doc["weather"]["temp"] = weather.temperature;
     doc["weather"]["humidity"] = weather.humidity;
     doc["weather"]["description"] = weather.description;
@@ -1191,20 +3928,95 @@ void setupWebServer()
     doc["lcd"]["line1"] = currentLCDLine1;
     doc["lcd"]["line2"] = currentLCDLine2;
     doc["lcd"]["mode"] = lcdDisplayMode;
+    doc["lcd"]["page"] = currentLcdPage().id;
+    doc["lcd"]["pages"] = lcdPageOrderString();
+    doc["lcd"]["dwell"] = lcdConfig.dwellSeconds;
+    doc["lcd"]["pageRenders"] = pageStats.renders;
+    doc["lcd"]["pageSkipped"] = pageStats.skipped;
+    doc["lcd"]["frames"] = lcdStats.frames;
+    doc["lcd"]["bytes"] = lcdStats.bytes;
+    doc["lcd"]["commands"] = displayStats.commands;
+    doc["lcd"]["coalesced"] = displayStats.coalesced;
+    doc["lcd"]["dropped"] = displayStats.dropped;
+    doc["lcd"]["bytesPerSec"] = lcdStats.bytesPerSec;
+    doc["lcd"]["i2cBytesPerSec"] = busStats.lcdI2cBytesPerSec;
+    doc["lcd"]["legacyI2cBytesPerSec"] = lcdStats.legacyBytesPerSec * LCD_I2C_BYTES_PER_LCD_BYTE;
+    doc["i2c"]["clockHz"] = busClockHz;
+    doc["i2c"]["lcdTransactions"] = busStats.lcdTransactions;
+    doc["i2c"]["lcdBusyUsPerSec"] = busStats.lcdBusyUsPerSec;
+    doc["i2c"]["lcdMaxTxUs"] = busStats.lcdMaxTxUs;
+    doc["i2c"]["rtcReads"] = busStats.rtcReads;
+    doc["i2c"]["rtcBusyUsPerSec"] = busStats.rtcBusyUsPerSec;
+    doc["i2c"]["busyPercent"] = (busStats.lcdBusyUsPerSec + busStats.rtcBusyUsPerSec) / 10000.0;
+    doc["inputs"]["state"] = inputState.load(std::memory_order_relaxed) & INPUT_MASK;
+    doc["inputs"]["samples"] = inputStats.samples;
+    doc["inputs"]["changes"] = inputStats.changes;
+    doc["inputs"]["maxSampleUs"] = inputStats.maxSampleUs;
+    doc["inputs"]["encoderSteps"] = encoderSteps.load(std::memory_order_relaxed);
+    doc["inputs"]["menuOpen"] = menu.open;
+    doc["button"]["gestures"] = buttonStats.gestures;
+    doc["button"]["dropped"] = buttonStats.dropped;
+    doc["button"]["buzzerKills"] = buzzerKillStats.kills;
+    doc["button"]["killIsrUs"] = buzzerKillStats.isrLastUs;
+    doc["button"]["killIsrMaxUs"] = buzzerKillStats.isrMaxUs;
+    doc["button"]["killProbes"] = buzzerKillStats.probes;
+    doc["button"]["killEdgeToSilenceNs"] = buzzerKillStats.edgeToSilenceNs;
+    doc["button"]["killEdgeToSilenceMaxNs"] = buzzerKillStats.edgeToSilenceMaxNs;
+    doc["button"]["loopLatencyUs"] = buzzerKillStats.loopLatencyUs;
+    doc["button"]["loopLatencyMaxUs"] = buzzerKillStats.loopLatencyMaxUs;
+    doc["tone"]["sounding"] = (bool)toneSounding;
+    doc["tone"]["notes"] = toneNotes;
+    doc["tone"]["duty"] = toneDuty;
     doc["hardware"]["lcd"] = hw.lcdOK;
     doc["hardware"]["rtc"] = hw.rtcOK;
     doc["hardware"]["wifi"] = hw.wifiOK;
     doc["hardware"]["temp"] = hw.tempOK;
     doc["hardware"]["buzzer"] = hw.buzzerOK;
     doc["hardware"]["led"] = hw.ledOK;
-    doc["timer"]["active"] = timer.active;
-    if (timer.active) {
-      unsigned long remaining = timer.duration - ((millis() - timer.startTime) / 1000);
-      doc["timer"]["remaining"] = remaining;
-      doc["timer"]["label"] = timer.label;
+    // "timer" is the soonest one, "timers" lists the whole pool
+    doc["timer"]["active"] = timerHeapSize > 0;
+    if (timerHeapSize > 0) {
+      doc["timer"]["remaining"] = timerRemaining(timerHeap[0]);
+      doc["timer"]["label"] = timers[timerHeap[0]].label;
+    }
+    doc["timerStore"]["commits"] = timerCommitCount;
+    doc["timerStore"]["pending"] = timersDirty;
+    doc["timerJitter"]["samples"] = timerJitter.samples;
+    doc["timerJitter"]["lastUs"] = timerJitter.lastUs;
+    doc["timerJitter"]["maxUs"] = timerJitter.maxUs;
+    doc["timerJitter"]["avgUs"] = timerJitter.samples ? (int32_t)(timerJitter.totalUs / timerJitter.samples) : 0;
+    doc["timerJitter"]["handleLastUs"] = timerJitter.lastHandleUs;
+    doc["timerJitter"]["handleMaxUs"] = timerJitter.maxHandleUs;
+    for (int i = 0; i < MAX_TIMERS; i++) {
+      if (!timers[i].active)
+        continue;
+      JsonObject t = doc["timers"].add<JsonObject>();
+      t["index"] = i;
+      t["label"] = timers[i].label;
+      t["duration"] = timers[i].duration;
+      t["remaining"] = timerRemaining(i);
+      if (timers[i].phaseCount > 0) {
+        t["phase"] = timers[i].phase;
+        t["phaseCount"] = timers[i].phaseCount;
+        t["phaseLabel"] = timers[i].phases[timers[i].phase].label;
+        t["round"] = timers[i].round;
+        t["rounds"] = timers[i].rounds;
+      }
     }
     doc["alarms"]["count"] = alarmCount;
     doc["alarms"]["active"] = alarmActive;
+    doc["alarms"]["nextFire"] = nextAlarmFireTime;
+    doc["alarms"]["holidays"] = holidayCount;
+    doc["alarms"]["snooze"]["duration"] = snoozeConfig.durationMinutes;
+    doc["alarms"]["snooze"]["max"] = snoozeConfig.maxCount;
+    doc["alarms"]["sunrise"]["minutes"] = sunriseConfig.minutes;
+    doc["alarms"]["sunrise"]["level"] = sunriseLevel;
+    doc["alarms"]["snooze"]["count"] = snooze.count;
+    doc["alarms"]["snooze"]["pending"] = snooze.fireTime != 0;
+    if (snooze.fireTime != 0) {
+      doc["alarms"]["snooze"]["fireTime"] = snooze.fireTime;
+      doc["alarms"]["snooze"]["index"] = snooze.alarmIndex;
+    }
     
     String response;
     serializeJson(doc, response);
@@ -1228,20 +4040,36 @@ void loadConfiguration()
     strcpy(config.hotspotPassword, "smartclock123");
   }
 
-  EEPROM.get(ALARM_ADDR, alarmCount);
-  if (alarmCount > 0 && alarmCount <= MAX_ALARMS)
+  // Header: count in the low 16 bits, record size in the high 16 bits (0 = records written
+  // before the recurrence fields existed). Records are read as a prefix of the current Alarm.
+  int alarmHeader = 0;
+  EEPROM.get(ALARM_ADDR, alarmHeader);
+  alarmCount = alarmHeader & 0xFFFF;
+  size_t recordSize = (alarmHeader >> 16) & 0xFFFF;
+  if (recordSize == 0)
+    recordSize = offsetof(Alarm, repeat);
+
+  if (alarmCount > 0 && alarmCount <= MAX_ALARMS && 4 + alarmCount * recordSize <= TIMER_ADDR - ALARM_ADDR)
   {
     for (int i = 0; i < alarmCount; i++)
     {
-      EEPROM.get(ALARM_ADDR + 4 + (i * sizeof(Alarm)), alarms[i]);
+      alarms[i] = Alarm();
+      uint8_t *dst = (uint8_t *)&alarms[i];
+      for (size_t b = 0; b < recordSize && b < sizeof(Alarm); b++)
+      {
+        dst[b] = EEPROM.read(ALARM_ADDR + 4 + i * recordSize + b);
+      }
     }
   }
   else
   {
     alarmCount = 0;
   }
+  compileAlarmRules();
+  loadHolidays();
+  loadTimers();
 
-  EEPROM.get(TIMER_ADDR, timer);
+  scheduleAlarms(readRtc().unixtime());
 }
 
 void saveConfiguration()
@@ -1253,12 +4081,190 @@ void saveConfiguration()
 
 void saveAlarms()
 {
-  EEPROM.put(ALARM_ADDR, alarmCount);
+  int alarmHeader = alarmCount | (sizeof(Alarm) << 16);
+  EEPROM.put(ALARM_ADDR, alarmHeader);
   for (int i = 0; i < alarmCount; i++)
   {
     EEPROM.put(ALARM_ADDR + 4 + (i * sizeof(Alarm)), alarms[i]);
   }
   EEPROM.commit();
+  compileAlarmRules();
+}
+
+// Restore running timers from their RTC deadlines; ones that ran out while powered off
+// alert once if they are recent, otherwise they are dropped
+void loadTimers()
+{
+  int timerHeader = 0;
+  EEPROM.get(TIMER_ADDR, timerHeader);
+  int count = timerHeader & 0xFFFF;
+  size_t recordSize = (timerHeader >> 16) & 0xFFFF;
+  if (recordSize < offsetof(SavedTimer, phaseCount) || count > MAX_TIMERS ||
+      TIMER_ADDR + 4 + count * recordSize > EEPROM_SIZE)
+    return;
+
+  uint32_t now = readRtc().unixtime();
+  for (int i = 0; i < count; i++)
+  {
+    SavedTimer saved;
+    uint8_t *dst = (uint8_t *)&saved;
+    for (size_t b = 0; b < recordSize && b < sizeof(SavedTimer); b++)
+    {
+      dst[b] = EEPROM.read(TIMER_ADDR + 4 + i * recordSize + b);
+    }
+    if (!saved.active)
+      continue;
+    saved.label[sizeof(saved.label) - 1] = '\0';
+
+    // Records from before program mode end at the label; the bytes read past it are
+    // struct padding, not a phase count
+    if (recordSize < offsetof(SavedTimer, phases) + sizeof(saved.phases))
+      saved.phaseCount = 0;
+
+    if (saved.deadlineUnix > now)
+    {
+      CountdownTimer setup;
+      setup.duration = saved.duration;
+      setup.deadlineUnix = saved.deadlineUnix;
+      strncpy(setup.label, saved.label, sizeof(setup.label) - 1);
+      setup.phaseCount = constrain(saved.phaseCount, 0, MAX_TIMER_PHASES);
+      setup.rounds = constrain(saved.rounds, 1, 99);
+      memcpy(setup.phases, saved.phases, sizeof(setup.phases));
+      for (TimerPhase &phase : setup.phases)
+        phase.label[sizeof(phase.label) - 1] = '\0';
+
+      uint32_t elapsed = saved.duration > saved.deadlineUnix - now ? saved.duration - (saved.deadlineUnix - now) : 0;
+      addTimer(setup, elapsed);
+      Serial.printf("Timer '%s' resumed, %lu s left\n", saved.label, (unsigned long)(saved.deadlineUnix - now));
+    }
+    else if (now - saved.deadlineUnix < TIMER_MISSED_ALERT_SEC)
+    {
+      timerAlert.triggered = true;
+      timerAlert.startTime = millis();
+      strncpy(timerAlert.label, saved.label, sizeof(timerAlert.label) - 1);
+      Serial.printf("Timer '%s' finished while powered off\n", saved.label);
+    }
+  }
+
+  // Persist what survived so expired records are not replayed on the next boot
+  timersDirty = true;
+}
+
+// Same commit path as saveAlarms(), skipped when the block is already up to date
+void saveTimers()
+{
+  // Zeroed so the padding bytes are the same on every save and the memcmp below is exact
+  SavedTimer saved[MAX_TIMERS];
+  memset((void *)saved, 0, sizeof(saved));
+  int count = 0;
+  for (int i = 0; i < MAX_TIMERS; i++)
+  {
+    if (!timers[i].active)
+      continue;
+    saved[count].deadlineUnix = timers[i].deadlineUnix;
+    saved[count].duration = timers[i].duration;
+    saved[count].active = true;
+    strncpy(saved[count].label, timers[i].label, sizeof(saved[count].label) - 1);
+    saved[count].phaseCount = timers[i].phaseCount;
+    saved[count].rounds = timers[i].rounds;
+    memcpy(saved[count].phases, timers[i].phases, sizeof(saved[count].phases));
+    count++;
+  }
+
+  int timerHeader = count | (sizeof(SavedTimer) << 16);
+  int storedHeader = 0;
+  EEPROM.get(TIMER_ADDR, storedHeader);
+  bool changed = storedHeader != timerHeader;
+  for (int i = 0; i < count && !changed; i++)
+  {
+    SavedTimer stored;
+    EEPROM.get(TIMER_ADDR + 4 + i * sizeof(SavedTimer), stored);
+    changed = memcmp(&stored, &saved[i], sizeof(SavedTimer)) != 0;
+  }
+  if (!changed)
+    return;
+
+  EEPROM.put(TIMER_ADDR, timerHeader);
+  for (int i = 0; i < count; i++)
+  {
+    EEPROM.put(TIMER_ADDR + 4 + i * sizeof(SavedTimer), saved[i]);
+  }
+  EEPROM.commit();
+  timerCommitCount++;
+}
+
+// Called every loop; commits at most once per TIMER_COMMIT_MIN_INTERVAL_MS unless forced
+void flushTimers(bool force)
+{
+  if (!timersDirty)
+    return;
+  if (!force && lastTimerCommit != 0 && millis() - lastTimerCommit < TIMER_COMMIT_MIN_INTERVAL_MS)
+    return;
+
+  saveTimers();
+  timersDirty = false;
+  lastTimerCommit = millis();
+}
+
+void loadHolidays()
+{
+  preferences.begin("alarm", false);
+  holidayCount = preferences.getBytes("holidays", holidays, sizeof(holidays)) / sizeof(holidays[0]);
+  preferences.end();
+}
+
+void saveHolidays()
+{
+  preferences.begin("alarm", false);
+  preferences.putBytes("holidays", holidays, holidayCount * sizeof(holidays[0]));
+  preferences.end();
+}
+
+void loadSnoozeConfig()
+{
+  preferences.begin("alarm", false);
+  snoozeConfig.durationMinutes = constrain(preferences.getInt("snoozeMin", 5), 1, 30);
+  snoozeConfig.maxCount = constrain(preferences.getInt("snoozeMax", 3), 0, 10);
+  sunriseConfig.minutes = constrain(preferences.getInt("sunriseMin", 10), 0, 60);
+  preferences.end();
+  armSunrise();
+}
+
+void saveSnoozeConfig()
+{
+  preferences.begin("alarm", false);
+  preferences.putInt("snoozeMin", snoozeConfig.durationMinutes);
+  preferences.putInt("snoozeMax", snoozeConfig.maxCount);
+  preferences.putInt("sunriseMin", sunriseConfig.minutes);
+  preferences.end();
+
+  Serial.println("Snooze config saved: " + String(snoozeConfig.durationMinutes) + " min x" + String(snoozeConfig.maxCount));
+}
+
+void loadLcdConfig()
+{
+  preferences.begin("lcd", false);
+  lcdConfig.scrollMs = constrain(preferences.getInt("scrollMs", 350), 100, 2000);
+  lcdConfig.vietnameseGlyphs = preferences.getBool("vnGlyphs", false);
+  lcdConfig.dwellSeconds = constrain(preferences.getInt("dwell", 60), 0, 3600);
+  String pages = preferences.getString("pages", "");
+  preferences.end();
+
+  if (pages.length() > 0)
+    parseLcdPageOrder(pages, lcdConfig);
+}
+
+void saveLcdConfig()
+{
+  preferences.begin("lcd", false);
+  preferences.putInt("scrollMs", lcdConfig.scrollMs);
+  preferences.putBool("vnGlyphs", lcdConfig.vietnameseGlyphs);
+  preferences.putInt("dwell", lcdConfig.dwellSeconds);
+  preferences.putString("pages", lcdPageOrderString());
+  preferences.end();
+
+  Serial.println("LCD config saved: scroll " + String(lcdConfig.scrollMs) + " ms, pages " + lcdPageOrderString() +
+                 " every " + String(lcdConfig.dwellSeconds) + " s");
 }
 
 void loadWeatherConfig()
@@ -1304,8 +4310,7 @@ void saveWeatherConfig()
 void tryConnectWiFiFirst()
 {
   // Removed LCD.clear() and LCD WiFi setup message
-  LCD.clear();
-  updateLCDContent("WiFi", "Connecting WiFi...");
+  displayNotice("WiFi", "Connecting WiFi...", 6000);
 
   Serial.println("[WiFi] Trying to connect to previously saved WiFi...");
 
@@ -1362,6 +4367,7 @@ void tryConnectWiFiFirst()
   {
     Serial.print("[WiFi] Connected! IP: ");
     Serial.println(WiFi.localIP());
+    displayNotice("WiFi connected", WiFi.localIP().toString().c_str(), 3000);
     // Stop the config portal and AP after successful connection
     wifiManager.stopConfigPortal();
     WiFi.softAPdisconnect(true); // This disables the AP interface
@@ -1370,6 +4376,7 @@ void tryConnectWiFiFirst()
   else
   {
     Serial.println("[WiFi] Failed to connect in 5 seconds. Starting WiFiManager AP mode...");
+    displayNotice("WiFi hotspot", config.hotspotSSID, 3000);
     wifiManager.setConfigPortalBlocking(false);
     wifiManager.startConfigPortal(config.hotspotSSID, config.hotspotPassword);
   }
@@ -1387,9 +4394,28 @@ void setupWiFi()
 // ==========================================
 void handleTimerAlarm()
 {
-  if (timer.alarmTriggered)
+  // Alert started: hand the buzzer to the timer melody. Over (timed out or stopped by
+  // the button): silence it and give the screen back
+  static bool timerOverlayShown = false;
+  if (timerAlert.triggered != timerOverlayShown)
+  {
+    timerOverlayShown = timerAlert.triggered;
+    if (timerOverlayShown)
+    {
+      buzzerKilled = false;
+      playMelody(MELODY_TIMER, 0, TONE_TIMER, PROFILE_CLASSIC);
+    }
+    else
+    {
+      stopMelody(TONE_TIMER);
+      if (!displayClearOverlay(LAYER_TIMER_ALERT))
+        timerOverlayShown = true; // still on screen, try again next loop
+    }
+  }
+
+  if (timerAlert.triggered)
   {
-    unsigned long alarmElapsed = millis() - timer.alarmStartTime;
+    unsigned long alarmElapsed = millis() - timerAlert.startTime;
 
     if (alarmElapsed < 5000)
     { // 5s alarm
@@ -1401,26 +4427,14 @@ void handleTimerAlarm()
         timerBlinkState = !timerBlinkState;
 
         if (timerBlinkState)
-        {
-          digitalWrite(BUZZER_PIN, HIGH);
-          digitalWrite(LED_PIN, HIGH);
-          updateLCDContent("*** TIMER ***", timer.label);
-        }
-        else
-        {
-          digitalWrite(BUZZER_PIN, LOW);
-          digitalWrite(LED_PIN, LOW);
-          LCD.clear();
-        }
+          displayOverlay(LAYER_TIMER_ALERT, "*** TIMER ***", timerAlert.label, 250);
       }
     }
     else
     {
       // Hết 5s thì tắt chuông
-      timer.alarmTriggered = false;
-      timer.finished = false;
-      digitalWrite(BUZZER_PIN, LOW);
-      digitalWrite(LED_PIN, LOW);
+      timerAlert.triggered = false;
+      stopMelody(TONE_TIMER);
       Serial.println("=== COUNTDOWN ALARM FINISHED ===");
     }
   }
@@ -1438,29 +4452,44 @@ void setup()
   Serial.println("=== Smart Clock v5.1 Enhanced ===");
   Serial.println("Initializing hardware...");
 
-  // Initialize button with internal pull-up
+  // Initialize buttons and the encoder with internal pull-ups
   pinMode(BUTTON_PIN, INPUT_PULLUP);
+  pinMode(SELECT_BUTTON_PIN, INPUT_PULLUP);
+  pinMode(BACK_BUTTON_PIN, INPUT_PULLUP);
+  pinMode(ENCODER_A_PIN, INPUT_PULLUP);
+  pinMode(ENCODER_B_PIN, INPUT_PULLUP);
   pinMode(LED_PIN, OUTPUT);
   pinMode(BUZZER_PIN, OUTPUT);
 
-  // Attach interrupt for immediate buzzer shutoff
+  // Countdown expiry clock (esp_timer one-shot + event queue)
+  setupTimerClock();
+
+  // Button: sampled debounce + gestures on an esp_timer, the interrupt only kills the buzzer
+  startInputSampler();
   attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonInterrupt, FALLING);
   Serial.println("✓ Button interrupt attached to GPIO 26");
+  encoderPhase = digitalRead(ENCODER_A_PIN) << 1 | digitalRead(ENCODER_B_PIN);
+  attachInterrupt(digitalPinToInterrupt(ENCODER_A_PIN), encoderInterrupt, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(ENCODER_B_PIN), encoderInterrupt, CHANGE);
 
   // Test LED and Buzzer at startup
-  digitalWrite(LED_PIN, HIGH);
-  digitalWrite(BUZZER_PIN, HIGH);
+  startTonePlayer();
+  startSunrise();
+  ledcWrite(LED_LEDC_CHANNEL, (1 << LED_LEDC_RESOLUTION) - 1);
+  ledcWriteTone(BUZZER_LEDC_CHANNEL, 2000);
   delay(200);
-  digitalWrite(LED_PIN, LOW);
-  digitalWrite(BUZZER_PIN, LOW);
+  ledcWrite(LED_LEDC_CHANNEL, 0);
+  ledcWriteTone(BUZZER_LEDC_CHANNEL, 0);
 
   // Initialize hardware
   LCD.init();
   LCD.backlight();
+  lcdClear();
+  startDisplayTask();
   hw.lcdOK = true;
   Serial.println("✓ LCD initialized");
 
-  if (rtc.begin())
+  if (rtcBegin())
   {
     hw.rtcOK = true;
     Serial.println("✓ RTC initialized");
@@ -1471,10 +4500,9 @@ void setup()
     Serial.println("✗ RTC failed");
   }
 
-  if (analogRead(NTC_PIN) > 0 && analogRead(NTC_PIN) < 4095)
+  if (startNtcAcquisition() && hw.tempOK)
   {
-    hw.tempOK = true;
-    currentTemp = convertAdcToTemperature(analogRead(NTC_PIN));
+    readTemperature();
     Serial.println("✓ Temperature sensor initialized");
   }
   else
@@ -1488,6 +4516,9 @@ void setup()
   hw.buzzerOK = true;
   Serial.println("✓ LED and Buzzer ready");
 
+  // EEPROM emulation must be mapped before any get/put/commit
+  EEPROM.begin(EEPROM_SIZE);
+
   // Check for first boot and clear data if needed
   if (checkFirstBoot())
   {
@@ -1497,6 +4528,8 @@ void setup()
 
   // Load configuration
   loadConfiguration();
+  loadSnoozeConfig();
+  loadLcdConfig();
   loadWeatherConfig();
 
   // Initialize LCD mode change timer
@@ -1584,27 +4617,21 @@ void loop()
   }
 
   // ===================== [D] ĐỌC CẢM BIẾN NHIỆT ĐỘ (Định kỳ 5 giây) =====================
+  // ntcTask already filtered it in the background, this only converts the latest value
   static unsigned long lastTempRead = 0;
   if (millis() - lastTempRead > 5000)
   {
     lastTempRead = millis();
-    if (hw.tempOK)
-    {
-      int adcValue = analogRead(NTC_PIN);
-      currentTemp = convertAdcToTemperature(adcValue);
-    }
+    readTemperature();
   }
 
   // ===================== [E] XỬ LÝ ALARM/TIMER, BUZZER, LED =====================
+  checkTimers();
+  flushTimers(false);
   handleTimerAlarm();
 
-  // ===================== [F] XỬ LÝ NÚT BẤM (Debounce mỗi 50ms) =====================
-  static unsigned long lastButtonCheck = 0;
-  if (millis() - lastButtonCheck > 50)
-  {
-    lastButtonCheck = millis();
-    handleButton();
-  }
+  // ===================== [F] XỬ LÝ NÚT BẤM (Sự kiện từ bộ lấy mẫu) =====================
+  handleButton();
 
   // ===================== [G] ĐỒNG BỘ RTC VỚI NTP (Khi mới có WiFi) =====================
   if (WiFi.status() == WL_CONNECTED && !rtcSynced)
@@ -1624,12 +4651,16 @@ void loop()
   switch (currentState)
   {
   case STATE_NORMAL:
-    displayClock();
+    displayPages();
+    displayCountdown();
     checkAlarms();
     break;
   case STATE_COUNTDOWN:
+    // The page keeps refreshing under the countdown layer, so it is current when the timers end
+    displayPages();
     displayCountdown();
-    if (!timer.active)
+    checkAlarms();
+    if (timerHeapSize == 0)
       currentState = STATE_NORMAL;
     break;
   case STATE_ALARM:
@@ -1638,7 +4669,12 @@ void loop()
   }
 
   // ===================== [Z] GIẢM TẢI CPU (Cho main loop mượt hơn) =====================
-  delay(100);
+  // Idle wait doubles as the timer wait: an expiring countdown wakes loop() immediately
+  TimerEvent pending;
+  if (timerEvents != nullptr)
+    xQueuePeek(timerEvents, &pending, pdMS_TO_TICKS(menu.open ? 20 : 100)); // the knob wants a snappier loop
+  else
+    delay(100);
 }
 
 // ==========================================
@@ -1765,24 +4801,35 @@ void fetchWeatherData()
 
 void checkAlarms()
 {
-  if (alarmActive || currentState != STATE_NORMAL)
+  if (alarmActive || currentState == STATE_ALARM || nextAlarmFireTime == 0)
     return;
 
-  DateTime now = rtc.now();
-  int currentDay = now.dayOfTheWeek();
+  uint32_t now = readRtc().unixtime();
+  if (now < nextAlarmFireTime)
+    return;
 
-  for (int i = 0; i < alarmCount; i++)
+  int index = nextAlarmFireIndex;
+  bool late = now - nextAlarmFireTime > ALARM_FIRE_GRACE_SEC;
+  if (nextAlarmIsSnooze)
   {
-    if (alarms[i].enabled &&
-        alarms[i].hour == now.hour() &&
-        alarms[i].minute == now.minute() &&
-        now.second() < 5 &&
-        alarms[i].daysOfWeek[currentDay])
-    {
-      triggerAlarm(i);
-      break;
-    }
+    snooze.fireTime = 0;
+  }
+  else if (index == snooze.alarmIndex)
+  {
+    // Ringing on schedule again: fresh snooze budget, stale re-fire no longer needed
+    snooze.fireTime = 0;
+    snooze.count = 0;
   }
+
+  scheduleAlarms(now + 1);
+
+  // Skip occurrences the clock jumped over (NTP correction, long blocking call)
+  if (late)
+  {
+    Serial.println("Alarm missed by more than grace period, skipping");
+    return;
+  }
+  triggerAlarm(index);
 }
 
 // Synchronize RTC with NTP time if WiFi is connected
@@ -1801,9 +4848,19 @@ void syncTimeWithNTP()
                   timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
                   timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
     // Set RTC from NTP time
-    rtc.adjust(DateTime(timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-                        timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec));
+    rtcAdjust(DateTime(timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
+                       timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec));
     Serial.println("[NTP] RTC updated from NTP.");
+    scheduleAlarms(readRtc().unixtime());
+
+    // Running timers keep their esp_timer deadline; re-anchor the saved RTC deadline to the new clock
+    uint32_t rtcNow = readRtc().unixtime();
+    for (int i = 0; i < MAX_TIMERS; i++)
+    {
+      if (timers[i].active)
+        timers[i].deadlineUnix = rtcNow + timerRemaining(i);
+    }
+    timersDirty = true;
   }
   else
   {
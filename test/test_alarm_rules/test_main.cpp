@@ -0,0 +1,168 @@
+// Property tests for the alarm recurrence engine: random rules, holidays and start instants
+// checked against a day-by-day evaluator. Run with `pio test -e native`.
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <AlarmRules.h>
+
+// Deterministic LCG so a failing case can be replayed: value in [lo, hi)
+static uint32_t seed = 20251018;
+static uint32_t randomRange(uint32_t lo, uint32_t hi)
+{
+  seed = seed * 1664525u + 1013904223u;
+  return lo + (seed >> 8) % (hi - lo);
+}
+
+static bool isLeap(int year)
+{
+  return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+// Reference evaluator: does the rule fire on this day?
+static bool bruteForceRuleMatches(const CompiledRule &rule, uint32_t day)
+{
+  if (rule.skipHolidays && isHoliday(day))
+    return false;
+
+  int year, month, dayOfMonth;
+  dateFromDay(day, year, month, dayOfMonth);
+  uint8_t dow = dayOfWeekFromDay(day);
+
+  switch (rule.kind)
+  {
+  case REPEAT_WEEKLY:
+    return rule.weekMask & (1 << dow);
+  case REPEAT_ONCE:
+    return day == rule.anchorDay;
+  case REPEAT_EVERY_N_DAYS:
+    return day >= rule.anchorDay && (day - rule.anchorDay) % rule.interval == 0;
+  case REPEAT_NTH_WEEKDAY:
+    if (dow != rule.weekday)
+      return false;
+    if (rule.nth >= 5)
+      return dayOfMonth + 7 > daysInMonth(year, month);
+    return (dayOfMonth - 1) / 7 == rule.nth - 1;
+  }
+  return false;
+}
+
+void setUp()
+{
+  holidayCount = 0;
+}
+
+void tearDown() {}
+
+// Walk the calendar one day at a time from 2000-01-01 (a Saturday) to 2150
+void test_day_numbers_match_calendar_walk()
+{
+  uint32_t day = 0;
+  for (int year = 2000; year < 2150; year++)
+  {
+    for (int month = 1; month <= 12; month++)
+    {
+      int length = month == 2 ? (isLeap(year) ? 29 : 28) : (month == 4 || month == 6 || month == 9 || month == 11 ? 30 : 31);
+      TEST_ASSERT_EQUAL_INT(length, daysInMonth(year, month));
+      for (int dayOfMonth = 1; dayOfMonth <= length; dayOfMonth++, day++)
+      {
+        TEST_ASSERT_EQUAL_UINT32(day, dayFromDate(year, month, dayOfMonth));
+        int y, m, d;
+        dateFromDay(day, y, m, d);
+        TEST_ASSERT_TRUE(y == year && m == month && d == dayOfMonth);
+        TEST_ASSERT_EQUAL_UINT8((6 + day) % 7, dayOfWeekFromDay(day));
+      }
+    }
+  }
+}
+
+void test_known_occurrences()
+{
+  // Last Monday of May 2025 is the 26th
+  TEST_ASSERT_EQUAL_UINT32(dayFromDate(2025, 5, 26), nthWeekdayOfMonth(2025, 5, 5, 1));
+  // Second Sunday of March 2024 is the 10th
+  TEST_ASSERT_EQUAL_UINT32(dayFromDate(2024, 3, 10), nthWeekdayOfMonth(2024, 3, 2, 0));
+
+  // Weekdays at 06:30 asked on Saturday 2025-10-18 10:00: Monday 20th 06:30
+  CompiledRule rule;
+  rule.weekMask = 0x3E;
+  rule.minuteOfDay = 6 * 60 + 30;
+  uint32_t from = EPOCH_2000_UNIX + dayFromDate(2025, 10, 18) * 86400UL + 10 * 3600;
+  TEST_ASSERT_EQUAL_UINT32(EPOCH_2000_UNIX + dayFromDate(2025, 10, 20) * 86400UL + rule.minuteOfDay * 60UL,
+                           nextRuleOccurrence(rule, from));
+
+  // ... and Tuesday when Monday is a holiday
+  rule.skipHolidays = true;
+  holidays[0] = dayFromDate(2025, 10, 20);
+  holidayCount = 1;
+  TEST_ASSERT_EQUAL_UINT32(EPOCH_2000_UNIX + dayFromDate(2025, 10, 21) * 86400UL + rule.minuteOfDay * 60UL,
+                           nextRuleOccurrence(rule, from));
+
+  // A one-off in the past never fires again
+  rule.kind = REPEAT_ONCE;
+  rule.anchorDay = dayFromDate(2025, 10, 17);
+  TEST_ASSERT_EQUAL_UINT32(0, nextRuleOccurrence(rule, from));
+}
+
+// Random rules, holidays and start instants over 2024..2034, each checked day by day
+void test_next_occurrence_matches_brute_force()
+{
+  const uint32_t firstDay = dayFromDate(2024, 1, 1);
+  const uint32_t span = dayFromDate(2034, 1, 1) - firstDay;
+  const uint32_t horizon = 3 * 366;
+
+  for (int iter = 0; iter < 5000; iter++)
+  {
+    CompiledRule rule;
+    rule.kind = randomRange(0, 4);
+    rule.weekMask = randomRange(0, 128);
+    rule.nth = randomRange(1, 6);
+    rule.weekday = randomRange(0, 7);
+    rule.interval = randomRange(1, 400);
+    rule.anchorDay = firstDay + randomRange(0, span);
+    rule.minuteOfDay = randomRange(0, 1440);
+    rule.skipHolidays = randomRange(0, 2);
+
+    // Clustered holidays so some candidates are excluded back to back
+    holidayCount = randomRange(0, MAX_HOLIDAYS + 1);
+    uint32_t holiday = rule.anchorDay - randomRange(0, 60);
+    for (int h = 0; h < holidayCount; h++)
+    {
+      holiday += randomRange(1, 20);
+      holidays[h] = holiday;
+    }
+
+    uint32_t from = EPOCH_2000_UNIX + (firstDay + randomRange(0, span)) * 86400UL + randomRange(0, 86400);
+    uint32_t got = nextRuleOccurrence(rule, from);
+
+    uint32_t expected = 0;
+    uint32_t startDay = (from - EPOCH_2000_UNIX) / 86400;
+    for (uint32_t day = startDay; day < startDay + horizon; day++)
+    {
+      uint32_t fire = EPOCH_2000_UNIX + day * 86400UL + rule.minuteOfDay * 60UL;
+      if (fire >= from && bruteForceRuleMatches(rule, day))
+      {
+        expected = fire;
+        break;
+      }
+    }
+
+    // Matches beyond the brute-force horizon are fine as long as the reference found none
+    bool beyondHorizon = expected == 0 && got >= EPOCH_2000_UNIX + (startDay + horizon) * 86400UL;
+    if (got != expected && !beyondHorizon)
+    {
+      char message[96];
+      snprintf(message, sizeof(message), "iter %d kind %d from %lu: got %lu", iter, rule.kind,
+               (unsigned long)from, (unsigned long)got);
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected, got, message);
+    }
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_day_numbers_match_calendar_walk);
+  RUN_TEST(test_known_occurrences);
+  RUN_TEST(test_next_occurrence_matches_brute_force);
+  return UNITY_END();
+}
@@ -0,0 +1,109 @@
+// HD44780 behind a PCF8574, fed with the exact expander bytes the LcdDisplay transport
+// puts on the bus. Only what the renderer uses is modelled: DDRAM/CGRAM writes, set
+// address, display on/off and clear.
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <LcdDisplay.h>
+
+#define MODEL_I2C_CLOCK 400000 // the firmware's LCD_I2C_CLOCK
+
+struct Hd44780Model
+{
+  char ddram[LCD_ROWS][40];
+  uint8_t cgram[64];
+  uint8_t address = 0; // DDRAM (0x00-0x27 row 0, 0x40-0x67 row 1) or CGRAM address
+  bool cgramMode = false;
+  bool displayOn = true;
+  uint8_t pins = 0;
+  bool lowNibbleNext = false;
+  uint8_t highNibble = 0;
+  uint32_t commands = 0;
+  uint32_t dataBytes = 0;
+  uint32_t cgramWrites = 0;
+  uint32_t transactions = 0;
+  uint32_t i2cBytes = 0; // address byte included
+  uint32_t busUs = 0;    // simulated wire time, 9 clocks per byte
+
+  Hd44780Model()
+  {
+    memset(ddram, ' ', sizeof(ddram));
+    memset(cgram, 0, sizeof(cgram));
+  }
+
+  uint32_t lcdBytes() const { return commands + dataBytes; }
+
+  void execute(uint8_t value, bool data)
+  {
+    if (data)
+    {
+      dataBytes++;
+      if (cgramMode)
+      {
+        cgram[address & 0x3F] = value;
+        address = (address + 1) & 0x3F;
+        cgramWrites++;
+        return;
+      }
+      int row = address >= 0x40 ? 1 : 0;
+      int col = address & 0x3F;
+      if (col < 40)
+        ddram[row][col] = value;
+      address = col + 1 < 40 ? address + 1 : (row ? 0x00 : 0x40);
+      return;
+    }
+
+    commands++;
+    if (value & 0x80)
+    {
+      address = value & 0x7F;
+      cgramMode = false;
+    }
+    else if (value & 0x40)
+    {
+      address = value & 0x3F;
+      cgramMode = true;
+    }
+    else if ((value & 0xF8) == 0x08)
+    {
+      displayOn = value & 0x04;
+    }
+    else if (value == 0x01)
+    {
+      memset(ddram, ' ', sizeof(ddram));
+      address = 0;
+      cgramMode = false;
+    }
+  }
+
+  // One I2C transaction. Nibbles latch on the falling edge of EN, high nibble first.
+  void feed(const uint8_t *bytes, int count)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      uint8_t next = bytes[i];
+      if ((pins & LCD_PCF_EN) && !(next & LCD_PCF_EN))
+      {
+        if (!lowNibbleNext)
+          highNibble = next & 0xF0;
+        else
+          execute(highNibble | (next >> 4), next & LCD_PCF_RS);
+        lowNibbleNext = !lowNibbleNext;
+      }
+      pins = next;
+    }
+    transactions++;
+    i2cBytes += count + 1;
+    busUs += (count + 1) * 9 * 1000000UL / MODEL_I2C_CLOCK;
+  }
+
+  // The visible window of one row
+  bool rowIs(int row, const char *text) const
+  {
+    char expected[LCD_COLS + 1];
+    memset(expected, ' ', LCD_COLS);
+    memcpy(expected, text, strnlen(text, LCD_COLS));
+    return memcmp(ddram[row], expected, LCD_COLS) == 0;
+  }
+};
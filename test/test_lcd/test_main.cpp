@@ -0,0 +1,301 @@
+// Golden frames and bus budgets for the LCD pipeline, run on the host with `pio test -e native`.
+// The LcdDisplay hooks feed an HD44780 model, so every assertion is about what would be on
+// the glass and on the wire.
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <LcdDisplay.h>
+#include "hd44780_model.h"
+
+// Bytes for one minute of the clock page (seconds tick + one minute roll). Raise these
+// only with a reason: they are what keeps the display from hogging the shared bus.
+#define CLOCK_MINUTE_LCD_BUDGET 140
+#define CLOCK_MINUTE_I2C_BUDGET 620
+
+static Hd44780Model model;
+static unsigned long fakeMillis = 0;
+
+unsigned long lcdMillis() { return fakeMillis; }
+void lcdBusWrite(const uint8_t *bytes, int count) { model.feed(bytes, count); }
+void lcdBusClear() { model.execute(0x01, false); }
+
+// What postDisplayLayer() hands the display task, applied and rendered synchronously
+static void post(uint8_t layer, const char *line1, const char *line2, uint8_t glyphs, uint16_t blinkMs, uint16_t ttlMs)
+{
+  DisplayCommand cmd = {DISPLAY_SET_LAYER, layer, 0, glyphs, blinkMs, ttlMs, "", ""};
+  if (line1)
+  {
+    utf8Copy(cmd.line1, sizeof(cmd.line1), line1, LCD_TEXT_MAX);
+    cmd.rowMask |= 1;
+  }
+  if (line2)
+  {
+    utf8Copy(cmd.line2, sizeof(cmd.line2), line2, LCD_TEXT_MAX);
+    cmd.rowMask |= 2;
+  }
+  applyDisplayCommand(cmd);
+  renderDisplay();
+}
+
+static void clearLayer(uint8_t layer)
+{
+  DisplayCommand cmd = {DISPLAY_CLEAR_LAYER, layer, 0, GLYPHS_ANY, 0, 0, "", ""};
+  applyDisplayCommand(cmd);
+  renderDisplay();
+}
+
+// Clock page at 2025-10-18, no WiFi, no alarms
+static void postClock(int hour, int minute, int second)
+{
+  char line1[LCD_TEXT_MAX + 1];
+  char line2[LCD_TEXT_MAX + 1];
+  uint8_t glyphs = formatClockLines(line1, line2, hour, minute, second, 18, 10, 2025, 27.5, "DISC");
+  post(LAYER_BASE, line1, line2, glyphs, 0, 0);
+}
+
+static void assertShows(const char *line1, const char *line2)
+{
+  char message[64];
+  snprintf(message, sizeof(message), "row 0 is '%.16s'", model.ddram[0]);
+  TEST_ASSERT_TRUE_MESSAGE(model.rowIs(0, line1), message);
+  snprintf(message, sizeof(message), "row 1 is '%.16s'", model.ddram[1]);
+  TEST_ASSERT_TRUE_MESSAGE(model.rowIs(1, line2), message);
+}
+
+void setUp()
+{
+  model = Hd44780Model();
+  fakeMillis = 1000;
+  lcdConfig = LcdConfig();
+  displayState = DisplayState();
+  displayStats = DisplayTaskStats();
+  lcdStats = LcdStats();
+  lcdBacklightOn = true;
+  lcdDisplayOn = true;
+  lcdTxLen = 0;
+  lcdClear();
+}
+
+void tearDown() {}
+
+// Deterministic LCG so a failing frame can be replayed
+static uint32_t nextRandom(uint32_t &state)
+{
+  state = state * 1664525u + 1013904223u;
+  return state >> 8;
+}
+
+void test_flush_keeps_ddram_equal_to_framebuffer()
+{
+  const uint32_t naiveFrame = LCD_ROWS * (1 + LCD_COLS); // setCursor + a full row, per row
+  uint32_t seed = 12345;
+  for (int frame = 0; frame < 2000; frame++)
+  {
+    // Mostly a few cells, sometimes a whole new screen
+    int changes = nextRandom(seed) % 8 == 0 ? LCD_ROWS * LCD_COLS : nextRandom(seed) % 6;
+    for (int i = 0; i < changes; i++)
+    {
+      int cell = nextRandom(seed) % (LCD_ROWS * LCD_COLS);
+      lcdFrame[cell / LCD_COLS][cell % LCD_COLS] = ' ' + nextRandom(seed) % 95;
+    }
+
+    uint32_t before = model.lcdBytes();
+    lcdFlush();
+    char message[48];
+    snprintf(message, sizeof(message), "frame %d", frame);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(lcdFrame[0], model.ddram[0], LCD_COLS, message);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(lcdFrame[1], model.ddram[1], LCD_COLS, message);
+    TEST_ASSERT_EQUAL_MEMORY(lcdFrame, lcdShown, sizeof(lcdFrame));
+    TEST_ASSERT_TRUE_MESSAGE(model.lcdBytes() - before <= naiveFrame, message);
+  }
+  TEST_ASSERT_EQUAL_UINT32(lcdStats.bytes, model.lcdBytes());
+}
+
+void test_flush_cost_of_small_changes()
+{
+  memcpy(lcdFrame[0], "12:00:00 27.5C  ", LCD_COLS);
+  lcdFlush();
+
+  // Nothing dirty: not even a transaction
+  uint32_t transactions = model.transactions;
+  uint32_t before = model.lcdBytes();
+  lcdFlush();
+  TEST_ASSERT_EQUAL_UINT32(transactions, model.transactions);
+  TEST_ASSERT_EQUAL_UINT32(before, model.lcdBytes());
+
+  // One cell: setCursor + the character, one transaction
+  lcdFrame[0][7] = '1';
+  lcdFlush();
+  TEST_ASSERT_EQUAL_UINT32(before + 2, model.lcdBytes());
+  TEST_ASSERT_EQUAL_UINT32(transactions + 1, model.transactions);
+
+  // Two cells one apart: the unchanged cell between them is cheaper than a second setCursor
+  before = model.lcdBytes();
+  lcdFrame[0][4] = '1';
+  lcdFrame[0][6] = '1';
+  lcdFlush();
+  TEST_ASSERT_EQUAL_UINT32(before + 1 + 3, model.lcdBytes());
+  TEST_ASSERT_TRUE(model.rowIs(0, "12:01:11 27.5C"));
+}
+
+void test_clock_golden_frame()
+{
+  postClock(7, 5, 9);
+  assertShows("07:05:09 27.5C", "18/10/25 DISC");
+}
+
+void test_clock_minute_within_bus_budget()
+{
+  postClock(7, 5, 9);
+  uint32_t lcdBefore = model.lcdBytes();
+  uint32_t i2cBefore = model.i2cBytes;
+  uint32_t busBefore = model.busUs;
+
+  int start = 7 * 3600 + 5 * 60 + 9;
+  for (int second = 1; second <= 60; second++)
+  {
+    int t = start + second;
+    postClock(t / 3600, t / 60 % 60, t % 60);
+  }
+  assertShows("07:06:09 27.5C", "18/10/25 DISC");
+
+  uint32_t lcdBytes = model.lcdBytes() - lcdBefore;
+  uint32_t i2cBytes = model.i2cBytes - i2cBefore;
+  printf("Clock page: %lu LCD bytes, %lu I2C bytes, %lu us on the bus per minute\n",
+         (unsigned long)lcdBytes, (unsigned long)i2cBytes, (unsigned long)(model.busUs - busBefore));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(CLOCK_MINUTE_LCD_BUDGET, lcdBytes);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(CLOCK_MINUTE_I2C_BUDGET, i2cBytes);
+  TEST_ASSERT_EQUAL_UINT32(lcdStats.bytes, model.lcdBytes()); // the firmware's counters match the wire
+}
+
+void test_big_clock_glyphs_uploaded_once()
+{
+  char line1[LCD_TEXT_MAX + 1];
+  char line2[LCD_TEXT_MAX + 1];
+  post(LAYER_BASE, line1, line2, formatBigClockLines(line1, line2, 12, 34, 1), 0, 0);
+  TEST_ASSERT_EQUAL_MEMORY(bigDigitGlyphs, model.cgram, sizeof(model.cgram));
+  assertShows(line1, line2);
+  TEST_ASSERT_EQUAL_MEMORY(bigDigitCells[1][0], model.ddram[0], 3);
+  TEST_ASSERT_EQUAL_MEMORY(bigDigitCells[4][1], model.ddram[1] + 13, 3);
+
+  uint32_t uploads = model.cgramWrites;
+  post(LAYER_BASE, line1, line2, formatBigClockLines(line1, line2, 12, 35, 2), 0, 0);
+  TEST_ASSERT_EQUAL_UINT32(uploads, model.cgramWrites);
+  TEST_ASSERT_EQUAL_UINT8(0xA5, (uint8_t)model.ddram[0][7]);
+  assertShows(line1, line2);
+}
+
+void test_countdown_covers_page_then_restores_it()
+{
+  postClock(7, 5, 9);
+  char line1[17];
+  formatCountdownLine(line1, sizeof(line1), 300, 0);
+  post(LAYER_COUNTDOWN, line1, "Pasta", GLYPHS_ANY, 0, 0);
+  assertShows("TIMER: 05:00", "Pasta");
+
+  // The page keeps ticking underneath
+  postClock(7, 5, 10);
+  assertShows("TIMER: 05:00", "Pasta");
+  formatCountdownLine(line1, sizeof(line1), 299, 2);
+  post(LAYER_COUNTDOWN, line1, "Pasta", GLYPHS_ANY, 0, 0);
+  assertShows("TIMER: 04:59 +2", "Pasta");
+
+  clearLayer(LAYER_COUNTDOWN);
+  assertShows("07:05:10 27.5C", "18/10/25 DISC");
+}
+
+void test_alarm_blink_only_toggles_display()
+{
+  postClock(7, 5, 9);
+  post(LAYER_ALARM, "*** ALARM ***", "WAKE UP!", GLYPHS_ANY, 500, 0);
+  assertShows("*** ALARM ***", "WAKE UP!");
+
+  for (int toggle = 0; toggle < 20; toggle++)
+  {
+    uint32_t commands = model.commands;
+    uint32_t data = model.dataBytes;
+    fakeMillis += 500;
+    stepDisplayBlink();
+    renderDisplay();
+    TEST_ASSERT_EQUAL(displayState.blinkVisible, model.displayOn);
+    TEST_ASSERT_EQUAL_UINT32(data, model.dataBytes);
+    TEST_ASSERT_EQUAL_UINT32(commands + 1, model.commands);
+  }
+
+  clearLayer(LAYER_ALARM);
+  TEST_ASSERT_TRUE(model.displayOn);
+  assertShows("07:05:09 27.5C", "18/10/25 DISC");
+}
+
+void test_notice_expires_after_ttl()
+{
+  postClock(7, 5, 9);
+  post(LAYER_NOTICE, "Saved", NULL, GLYPHS_ANY, 0, 2000);
+  assertShows("Saved", "18/10/25 DISC");
+
+  fakeMillis += 1999;
+  TEST_ASSERT_EQUAL_UINT32(1, expireDisplayLayers(60000));
+  fakeMillis += 1;
+  expireDisplayLayers(60000);
+  renderDisplay();
+  assertShows("07:05:09 27.5C", "18/10/25 DISC");
+}
+
+void test_long_line_scrolls_in_place()
+{
+  post(LAYER_BASE, "Weather: light rain in the afternoon", "", GLYPHS_ANY, 0, 0);
+  assertShows("Weather: light r", "");
+
+  uint32_t lcdBefore = model.lcdBytes();
+  fakeMillis += MARQUEE_HOLD_MS;
+  stepMarquees(60000);
+  renderDisplay();
+  assertShows("eather: light ra", "");
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(1 + LCD_COLS, model.lcdBytes() - lcdBefore);
+}
+
+void test_transliteration()
+{
+  char out[LCD_LINE_MAX + 1];
+  lcdTransliterate("Đà Nẵng 25°C", out, sizeof(out), false);
+  TEST_ASSERT_EQUAL_STRING("Da Nang 25\xDF" "C", out);
+
+  // Decomposed (NFD) input: base letters plus combining circumflex, breve, horn and tones
+  lcdTransliterate("Tie\u0302\u0301ng Vie\u0323\u0302t, na\u0306m mu\u031Bo\u031B\u0300i", out, sizeof(out), false);
+  TEST_ASSERT_EQUAL_STRING("Tieng Viet, nam muoi", out);
+
+  // Nothing we know how to draw
+  lcdTransliterate("5€", out, sizeof(out), false);
+  TEST_ASSERT_EQUAL_STRING("5?", out);
+}
+
+// Text pages with the Vietnamese set: CGRAM uploaded once, letters drawn from codes 8-15
+void test_vietnamese_glyphs_golden_frame()
+{
+  lcdConfig.vietnameseGlyphs = true;
+  post(LAYER_BASE, "Đà Nẵng 25°C", "Thứ Hai", GLYPHS_ANY, 0, 0);
+  TEST_ASSERT_EQUAL_MEMORY(vietnameseGlyphs, model.cgram, sizeof(model.cgram));
+  assertShows("\x0F" "a N\x08" "ng 25\xDF" "C", "Th\x0E Hai");
+
+  uint32_t uploads = model.cgramWrites;
+  post(LAYER_BASE, "Đà Nẵng 26°C", "Thứ Hai", GLYPHS_ANY, 0, 0);
+  TEST_ASSERT_EQUAL_UINT32(uploads, model.cgramWrites);
+  assertShows("\x0F" "a N\x08" "ng 26\xDF" "C", "Th\x0E Hai");
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_flush_keeps_ddram_equal_to_framebuffer);
+  RUN_TEST(test_flush_cost_of_small_changes);
+  RUN_TEST(test_clock_golden_frame);
+  RUN_TEST(test_clock_minute_within_bus_budget);
+  RUN_TEST(test_big_clock_glyphs_uploaded_once);
+  RUN_TEST(test_countdown_covers_page_then_restores_it);
+  RUN_TEST(test_alarm_blink_only_toggles_display);
+  RUN_TEST(test_notice_expires_after_ttl);
+  RUN_TEST(test_long_line_scrolls_in_place);
+  RUN_TEST(test_transliteration);
+  RUN_TEST(test_vietnamese_glyphs_golden_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,80 @@
+// The compile-time NTC table against the Beta equation evaluated with libm, plus a timing of
+// both conversions. Run with `pio test -e native`; the timings are printed, not asserted,
+// since they depend on the host.
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <unity.h>
+#include <NtcTable.h>
+
+static float equationCelsius(int code)
+{
+  return 1.0f / (logf(code / (4095.0f - code)) / NTC_BETA + 1.0f / NTC_T0_KELVIN) - 273.15f;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Every code whose temperature is in the sensor's range, within 0.15 °C of the equation
+void test_table_matches_equation()
+{
+  float worst = 0;
+  for (int code = 1; code < 4095; code++)
+  {
+    float reference = equationCelsius(code);
+    if (reference < -40 || reference > 125)
+      continue;
+    float error = fabsf(ntcCentiCelsius(code) * 0.01f - reference);
+    if (error > worst)
+      worst = error;
+    char message[48];
+    snprintf(message, sizeof(message), "code %d", code);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.15f, reference, ntcCentiCelsius(code) * 0.01f, message);
+  }
+  printf("NTC table: worst error %.3f C over -40..125 C\n", worst);
+}
+
+// Hotter = lower code, and codes off the rails clamp instead of reading past the table
+void test_table_is_monotonic_and_clamped()
+{
+  for (int code = 1; code < 4096; code++)
+    TEST_ASSERT_TRUE(ntcCentiCelsius(code) <= ntcCentiCelsius(code - 1));
+  TEST_ASSERT_EQUAL_INT(ntcCentiCelsius(0), ntcCentiCelsius(-5));
+  TEST_ASSERT_EQUAL_INT(ntcCentiCelsius(4095), ntcCentiCelsius(5000));
+  TEST_ASSERT_EQUAL_INT(NTC_MAX_CENTI, ntcCentiCelsius(0));
+  TEST_ASSERT_EQUAL_INT(NTC_MIN_CENTI, ntcCentiCelsius(4095));
+}
+
+// Every code through both paths, repeated so the clock resolution does not matter
+void test_benchmark_table_against_equation()
+{
+  const int passes = 200;
+  volatile int codeBase = 0; // keeps the compiler from folding the table calls
+  volatile float sink = 0;
+  typedef std::chrono::steady_clock Clock;
+
+  Clock::time_point t0 = Clock::now();
+  for (int pass = 0; pass < passes; pass++)
+    for (int code = 0; code < 4096; code++)
+      sink = sink + ntcCentiCelsius(codeBase + code) * 0.01f;
+  double tableNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+
+  t0 = Clock::now();
+  for (int pass = 0; pass < passes; pass++)
+    for (int code = 1; code < 4095; code++)
+      sink = sink + equationCelsius(codeBase + code);
+  double equationNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+
+  double conversions = passes * 4096.0;
+  printf("NTC conversion on this host: table %.1f ns, equation %.1f ns (%.1fx)\n",
+         tableNs / conversions, equationNs / conversions, equationNs / tableNs);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_table_matches_equation);
+  RUN_TEST(test_table_is_monotonic_and_clamped);
+  RUN_TEST(test_benchmark_table_against_equation);
+  return UNITY_END();
+}